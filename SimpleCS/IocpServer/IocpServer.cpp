@@ -5,6 +5,7 @@
 
 #include <iostream>
 #include "reflib_net_service.h"
+#include "reflib_page_arena.h"
 #include "game_net_obj.h"
 
 #pragma comment(lib,"WS2_32")
@@ -28,23 +29,24 @@ int main()
     unsigned port = 5150;
     unsigned maxConn = 3000;
 
+    // rings and pool slabs fall back to normal pages when this is not granted
+    g_pageArena.EnableLargePages();
+
     auto netService = std::make_shared<NetServerService>();
     if (!netService->Initialize(maxConn, getSystemInfo().dwNumberOfProcessors))
         return -1;
 
-    for (size_t i = 0; i < maxConn; ++i)
-    {
-        auto obj = std::make_shared<GameNetObj>(netService);
-		if (!netService->AddListeningObj(obj))
-		{
-			return -1;
-		}
-    }
+    // GameNetObjs are built per accepted connection instead of up front
+    std::weak_ptr<NetService> container = netService;
+    netService->SetNetObjFactory([container]() {
+        return std::make_shared<GameNetObj>(container);
+    });
 
     netService->StartListen(port);
 
     getchar();
 
+    netService->PrintStatistics();
     netService->Shutdown();
 
     return 0;
@@ -16,7 +16,11 @@ public:
     }
 
     uint32 GetSlotId() const { return _id; }
-    uint64 GetIndex() const { return ((_id & UINT64_MAX) << 32 | _salt); }
+    uint32 GetSalt() const { return _salt; }
+    uint64 GetIndex() const
+    {
+        return (static_cast<uint64>(static_cast<unsigned int>(_id)) << 32) | static_cast<unsigned int>(_salt);
+    }
 
     // call when NetConnection is reused.
     void IncSalt()
@@ -3,3 +3,22 @@
 #define THREAD_TIMEOUT_IN_MSEC	1000
 
 #define INVALID_OBJ_ID  0
+
+#define MEMORY_POOL_MIN_CLASS_SHIFT     6       // 64 bytes
+#define MEMORY_POOL_MAX_CLASS_SHIFT     16      // 64 KB
+#define MEMORY_POOL_CLASS_CNT           (MEMORY_POOL_MAX_CLASS_SHIFT - MEMORY_POOL_MIN_CLASS_SHIFT + 1)
+#define MEMORY_POOL_SLAB_SIZE           ((1024)*(256))
+#define MEMORY_POOL_MAX_SLAB_BLOCKS     64
+#define MEMORY_POOL_MAGAZINE_SIZE       32
+#define MEMORY_POOL_PUBLISH_OPS         64      // unpublished gets and frees per thread
+
+#define MEMORY_ARENA_CHUNK_SIZE         ((1024)*(1024)*(16))
+#define MEMORY_ARENA_ALIGN              4096
+#define MEMORY_ARENA_FREE_KEEP          8       // committed free ranges kept per size
+
+#define NUMA_MAX_NODE_CNT               8
+#define NUMA_NODE_ANY                   (-1)
+
+#define TICK_ARENA_BLOCK_SIZE           ((1024)*(64))
+
+#define SLOT_LIST_END                   (-1)
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include "reflib_memory_block.h"
+#include "reflib_memory_pool.h"
 
 namespace RefLib
 {
@@ -10,12 +11,16 @@ MemoryBlock::MemoryBlock()
     : _data(nullptr)
     , _dataLen(0)
     , _capacity(0)
+    , _sizeClass(MEMORY_BLOCK_HEAP_CLASS)
+    , _node(NUMA_NODE_ANY)
+    , _tag(MEMORY_TAG_USER)
+    , _refCnt(1)
 {
 }
 
 MemoryBlock::~MemoryBlock()
 {
-    REFLIB_ASSERT(!_data, "Memory leak detected!");
+    REFLIB_ASSERT(!_data || _sizeClass != MEMORY_BLOCK_HEAP_CLASS, "Memory leak detected!");
     DestroyMem();
 }
 
@@ -29,27 +34,62 @@ void MemoryBlock::CreateMem(uint32 len)
 
 void MemoryBlock::DestroyMem()
 {
-    SAFE_DELETE_ARRAY(_data);
+    if (_sizeClass == MEMORY_BLOCK_HEAP_CLASS)
+    {
+        SAFE_DELETE_ARRAY(_data);
+    }
+    _data = nullptr;
     _dataLen = 0;
+    _capacity = 0;
+    _sizeClass = MEMORY_BLOCK_HEAP_CLASS;
+    _node = NUMA_NODE_ANY;
+}
+
+void MemoryBlock::AttachMem(char* data, uint32 capacity, int sizeClass, int node)
+{
+    DestroyMem();
+
+    _data = data;
+    _capacity = capacity;
+    _dataLen = 0;
+    _sizeClass = sizeClass;
+    _node = node;
 }
 
 void MemoryBlock::Resize(uint32 len)
 {
-    if (len < _capacity)
+    REFLIB_ASSERT(!IsShared(), "Resizing a shared block");
+
+    if (len <= _capacity)
     {
         _dataLen = len;
     }
-    else if (len > _capacity)
+    else
     {
-        char* data = new char[len];
+        g_memoryPool.Grow(this, len);
+    }
+}
 
-        memcpy_s(data, len, _data, _dataLen);
+// True when the caller held the last reference. A sole owner skips the atomic
+// decrement: nobody else can add a reference to a block they cannot see.
+bool MemoryBlock::ReleaseRef()
+{
+    if (_refCnt.load(std::memory_order_acquire) == 1)
+    {
+        _refCnt.store(0, std::memory_order_relaxed);
+        return true;
+    }
 
-        std::swap(_data, data);
-        _capacity = len;
+    return (_refCnt.fetch_sub(1, std::memory_order_acq_rel) == 1);
+}
 
-        delete[] data;
-    }
+void MemoryBlock::Swap(MemoryBlock& rhs)
+{
+    std::swap(_data, rhs._data);
+    std::swap(_dataLen, rhs._dataLen);
+    std::swap(_capacity, rhs._capacity);
+    std::swap(_sizeClass, rhs._sizeClass);
+    std::swap(_node, rhs._node);
 }
 
 } // namespace RefLib
@@ -1,26 +1,63 @@
 #pragma once
 
+#include <atomic>
+#include "reflib_def.h"
+
 namespace RefLib
 {
 
+#define MEMORY_BLOCK_HEAP_CLASS     (-1)
+
+// subsystem a block is charged to while it is outstanding
+enum MemoryTag
+{
+    MEMORY_TAG_USER,
+    MEMORY_TAG_RECV,    // buffers of posted reads
+    MEMORY_TAG_SEND,    // framed packets waiting to be sent
+    MEMORY_TAG_PACKET,  // received packets handed to NetObj
+    MEMORY_TAG_CNT,
+};
+
 class MemoryBlock
 {
 public:
     MemoryBlock();
     virtual ~MemoryBlock();
 
+    // heap payload, used for sizes above the largest pool class
     void CreateMem(uint32 len);
     void DestroyMem();
 
+    // payload carved from a pool slab; owned by the pool, not the block
+    void AttachMem(char* data, uint32 capacity, int sizeClass, int node);
+
     char* GetData() { return _data; }
     uint32 GetDataLen() const { return _dataLen; }
+    uint32 GetCapacity() const { return _capacity; }
+    int GetSizeClass() const { return _sizeClass; }
+    int GetNode() const { return _node; }
+    MemoryTag GetTag() const { return _tag; }
 
+    void SetTag(MemoryTag tag) { _tag = tag; }
+    void SetDataLen(uint32 len) { _dataLen = len; }
     void Resize(uint32 len);
+    void Swap(MemoryBlock& rhs);
+
+    // Intrusive reference count. The pool hands a block out with one reference
+    // and takes it back when FreeBuffer drops the last one.
+    void AddRef() { _refCnt.fetch_add(1, std::memory_order_relaxed); }
+    bool ReleaseRef();
+    void ResetRef() { _refCnt.store(1, std::memory_order_relaxed); }
+    bool IsShared() const { return _refCnt.load(std::memory_order_acquire) > 1; }
 
 private:
     char* _data;
     uint32 _dataLen;
     uint32 _capacity;
+    int _sizeClass;
+    int _node;
+    MemoryTag _tag;
+    std::atomic<int> _refCnt;
 };
 
 } // namespace RefLib
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <utility>
+#include "reflib_memory_pool.h"
+
+namespace RefLib
+{
+
+// Shared handle over a pooled MemoryBlock. Copies add a reference, moves
+// do not, and the last handle gives the block back to g_memoryPool.
+class MemoryBlockPtr
+{
+public:
+    MemoryBlockPtr() : _block(nullptr) {}
+
+    // adopts the reference the caller holds, e.g. one fresh from GetBuffer
+    explicit MemoryBlockPtr(MemoryBlock* block) : _block(block) {}
+
+    MemoryBlockPtr(const MemoryBlockPtr& rhs)
+        : _block(rhs._block)
+    {
+        if (_block)
+            _block->AddRef();
+    }
+
+    MemoryBlockPtr(MemoryBlockPtr&& rhs)
+        : _block(rhs._block)
+    {
+        rhs._block = nullptr;
+    }
+
+    ~MemoryBlockPtr() { Reset(); }
+
+    MemoryBlockPtr& operator=(MemoryBlockPtr rhs)
+    {
+        std::swap(_block, rhs._block);
+        return *this;
+    }
+
+    void Reset()
+    {
+        if (_block)
+        {
+            g_memoryPool.FreeBuffer(_block);
+            _block = nullptr;
+        }
+    }
+
+    // hand the reference to code that frees with FreeBuffer
+    MemoryBlock* Detach()
+    {
+        MemoryBlock* block = _block;
+        _block = nullptr;
+        return block;
+    }
+
+    MemoryBlock* Get() const { return _block; }
+    MemoryBlock* operator->() const { return _block; }
+    explicit operator bool() const { return _block != nullptr; }
+
+private:
+    MemoryBlock* _block;
+};
+
+} // namespace RefLib
@@ -1,22 +1,80 @@
 #include "stdafx.h"
 
+#include <intrin.h>
+#include <new>
 #include "reflib_memory_pool.h"
+#include "reflib_page_arena.h"
+#include "reflib_numa.h"
 
 namespace RefLib
 {
 
+thread_local MemoryPool::ThreadCache MemoryPool::_threadCache;
+
+MemoryPool::ThreadCache::ThreadCache()
+    : _node(NUMA_NODE_ANY)
+    , _unpublished(0)
+{
+    memset(_loaded, 0, sizeof(_loaded));
+    memset(_previous, 0, sizeof(_previous));
+    memset(_remote, 0, sizeof(_remote));
+    memset(_inUse, 0, sizeof(_inUse));
+    memset(_tagBlocks, 0, sizeof(_tagBlocks));
+    memset(_tagBytes, 0, sizeof(_tagBytes));
+}
+
+MemoryPool::ThreadCache::~ThreadCache()
+{
+    // the node is resolved on the first get or free, so an untouched cache holds nothing
+    if (_node != NUMA_NODE_ANY)
+    {
+        g_memoryPool.FlushThreadCache();
+    }
+}
+
 MemoryPool::MemoryPool()
 {
+    for (int i = 0; i < MEMORY_TAG_CNT; ++i)
+    {
+        _tagBlocks[i] = 0;
+        _tagBytes[i] = 0;
+    }
 }
 
 MemoryPool::~MemoryPool()
 {
     MemoryBlock* buffer = nullptr;
+    MemoryMagazine* magazine = nullptr;
 
     while (_freeBuffers.try_pop(buffer))
     {
         SAFE_DELETE(buffer);
     }
+
+    // blocks still cached by other threads are not reclaimed here
+    for (auto& nodeMagazines : _fullMagazines)
+    {
+        for (auto& fullMagazines : nodeMagazines)
+        {
+            while (fullMagazines.try_pop(magazine))
+            {
+                while (!magazine->IsEmpty())
+                {
+                    buffer = magazine->Pop();
+                    buffer->DestroyMem();
+                    SAFE_DELETE(buffer);
+                }
+                SAFE_DELETE(magazine);
+            }
+        }
+    }
+
+    while (_emptyMagazines.try_pop(magazine))
+    {
+        SAFE_DELETE(magazine);
+    }
+
+    // slab memory belongs to the page arena and is unmapped with it
 }
 
 bool MemoryPool::Initialize(unsigned int reserve)
@@ -30,15 +88,272 @@ bool MemoryPool::Initialize(unsigned int reserve)
     return true;
 }
 
-MemoryBlock* MemoryPool::GetBuffer(unsigned int bufLen)
+int MemoryPool::GetSizeClass(unsigned int len)
+{
+    if (len <= (1u << MEMORY_POOL_MIN_CLASS_SHIFT))
+        return 0;
+    if (len > (1u << MEMORY_POOL_MAX_CLASS_SHIFT))
+        return MEMORY_BLOCK_HEAP_CLASS;
+
+    // ceil(log2(len))
+    unsigned long msb = 0;
+    _BitScanReverse(&msb, len - 1);
+
+    return static_cast<int>(msb + 1) - MEMORY_POOL_MIN_CLASS_SHIFT;
+}
+
+MemoryMagazine* MemoryPool::GetEmptyMagazine()
+{
+    MemoryMagazine* magazine = nullptr;
+    if (!_emptyMagazines.try_pop(magazine))
+    {
+        magazine = new MemoryMagazine();
+    }
+
+    return magazine;
+}
+
+void MemoryPool::ReturnMagazine(int sizeClass, int node, MemoryMagazine* magazine)
+{
+    if (magazine->IsEmpty())
+        _emptyMagazines.push(magazine);
+    else
+        _fullMagazines[node][sizeClass].push(magazine);
+}
+
+int MemoryPool::GetThreadNode()
+{
+    if (_threadCache._node == NUMA_NODE_ANY)
+    {
+        _threadCache._node = GetCurrentNumaNode();
+    }
+
+    return _threadCache._node;
+}
+
+void MemoryPool::SetThreadNode(int node)
+{
+    REFLIB_ASSERT_RETURN_IF_FAILED(node >= 0 && node < NUMA_MAX_NODE_CNT, "Invalid NUMA node");
+
+    if (_threadCache._node == node)
+        return;
+
+    FlushThreadCache();
+    _threadCache._node = node;
+}
+
+// Carve a new slab on the node into blocks of one class. The given magazine is
+// filled first, any blocks left over go to the node's depot as extra magazines.
+unsigned int MemoryPool::CarveSlab(int sizeClass, int node, MemoryMagazine* magazine, bool prefault)
+{
+    unsigned int classSize = GetClassSize(sizeClass);
+    unsigned int blockCnt = (std::min)(MEMORY_POOL_SLAB_SIZE / classSize, static_cast<unsigned int>(MEMORY_POOL_MAX_SLAB_BLOCKS));
+    blockCnt = (std::max)(blockCnt, 1u);
+
+    char* slab = g_pageArena.Alloc(classSize * blockCnt, node);
+    if (!slab)
+        throw std::bad_alloc();
+
+    if (prefault)
+        memset(slab, 0, classSize * blockCnt);
+
+    _classStats[sizeClass]._carved.fetch_add(blockCnt, std::memory_order_relaxed);
+
+    MemoryMagazine* spare = nullptr;
+    for (unsigned int i = 0; i < blockCnt; ++i)
+    {
+        MemoryBlock* buffer = new MemoryBlock();
+        buffer->AttachMem(slab + i * classSize, classSize, sizeClass, node);
+
+        if (!magazine->IsFull())
+        {
+            magazine->Push(buffer);
+            continue;
+        }
+
+        if (spare && spare->IsFull())
+        {
+            _fullMagazines[node][sizeClass].push(spare);
+            spare = nullptr;
+        }
+        if (!spare)
+        {
+            spare = GetEmptyMagazine();
+        }
+        spare->Push(buffer);
+    }
+
+    if (spare)
+    {
+        _fullMagazines[node][sizeClass].push(spare);
+    }
+
+    return blockCnt;
+}
+
+void MemoryPool::Prefill(int sizeClass, unsigned int count)
+{
+    REFLIB_ASSERT_RETURN_IF_FAILED(sizeClass >= 0 && sizeClass < MEMORY_POOL_CLASS_CNT, "Invalid size class");
+
+    int node = GetThreadNode();
+
+    unsigned int carved = 0;
+    while (carved < count)
+    {
+        MemoryMagazine* magazine = GetEmptyMagazine();
+        carved += CarveSlab(sizeClass, node, magazine, true);
+        ReturnMagazine(sizeClass, node, magazine);
+    }
+}
+
+MemoryBlock* MemoryPool::AllocBlock(int sizeClass)
+{
+    int node = GetThreadNode();
+
+    MemoryMagazine*& loaded = _threadCache._loaded[sizeClass];
+    MemoryMagazine*& previous = _threadCache._previous[sizeClass];
+
+    if (loaded && !loaded->IsEmpty())
+        return loaded->Pop();
+
+    if (previous && !previous->IsEmpty())
+    {
+        std::swap(loaded, previous);
+        return loaded->Pop();
+    }
+
+    // both magazines are empty: trade one in for a stocked magazine from the depot
+    PublishStats();
+
+    MemoryMagazine* stocked = nullptr;
+    if (!_fullMagazines[node][sizeClass].try_pop(stocked))
+    {
+        stocked = GetEmptyMagazine();
+        CarveSlab(sizeClass, node, stocked);
+    }
+
+    if (previous)
+    {
+        _emptyMagazines.push(previous);
+    }
+    previous = loaded;
+    loaded = stocked;
+
+    return loaded->Pop();
+}
+
+void MemoryPool::FreeBlock(MemoryBlock* obj)
+{
+    int node = GetThreadNode();
+    if (obj->GetNode() != node)
+    {
+        FreeRemoteBlock(obj);
+        return;
+    }
+
+    int sizeClass = obj->GetSizeClass();
+
+    MemoryMagazine*& loaded = _threadCache._loaded[sizeClass];
+    MemoryMagazine*& previous = _threadCache._previous[sizeClass];
+
+    if (loaded && !loaded->IsFull())
+    {
+        loaded->Push(obj);
+        return;
+    }
+
+    if (previous && !previous->IsFull())
+    {
+        std::swap(loaded, previous);
+        loaded->Push(obj);
+        return;
+    }
+
+    // both magazines are full: hand one to the depot and load an empty one
+    PublishStats();
+
+    if (previous)
+    {
+        _fullMagazines[node][sizeClass].push(previous);
+    }
+    previous = loaded;
+    loaded = GetEmptyMagazine();
+    loaded->Push(obj);
+}
+
+void MemoryPool::FreeRemoteBlock(MemoryBlock* obj)
+{
+    int node = obj->GetNode();
+    int sizeClass = obj->GetSizeClass();
+
+    MemoryMagazine*& remote = _threadCache._remote[node][sizeClass];
+    if (!remote)
+    {
+        remote = GetEmptyMagazine();
+    }
+
+    remote->Push(obj);
+
+    if (remote->IsFull())
+    {
+        _fullMagazines[node][sizeClass].push(remote);
+        remote = nullptr;
+    }
+}
+
+void MemoryPool::FlushThreadCache()
+{
+    int node = _threadCache._node;
+
+    PublishStats();
+
+    for (int i = 0; i < MEMORY_POOL_CLASS_CNT; ++i)
+    {
+        if (_threadCache._loaded[i])
+        {
+            ReturnMagazine(i, node, _threadCache._loaded[i]);
+            _threadCache._loaded[i] = nullptr;
+        }
+        if (_threadCache._previous[i])
+        {
+            ReturnMagazine(i, node, _threadCache._previous[i]);
+            _threadCache._previous[i] = nullptr;
+        }
+
+        for (int remoteNode = 0; remoteNode < NUMA_MAX_NODE_CNT; ++remoteNode)
+        {
+            MemoryMagazine*& remote = _threadCache._remote[remoteNode][i];
+            if (remote)
+            {
+                ReturnMagazine(i, remoteNode, remote);
+                remote = nullptr;
+            }
+        }
+    }
+}
+
+MemoryBlock* MemoryPool::GetBuffer(unsigned int bufLen, MemoryTag tag)
 {
     MemoryBlock *newObj = nullptr;
 
-    if (!_freeBuffers.try_pop(newObj))
+    int sizeClass = GetSizeClass(bufLen);
+    if (sizeClass == MEMORY_BLOCK_HEAP_CLASS)
     {
-        newObj = new MemoryBlock();
+        if (!_freeBuffers.try_pop(newObj))
+        {
+            newObj = new MemoryBlock();
+        }
+        newObj->CreateMem(bufLen);
     }
-    newObj->CreateMem(bufLen);
+    else
+    {
+        newObj = AllocBlock(sizeClass);
+        newObj->SetDataLen(bufLen);
+    }
+
+    newObj->ResetRef();
+    newObj->SetTag(tag);
+    CountGet(newObj);
 
     return newObj;
 }
@@ -47,8 +362,146 @@ void MemoryPool::FreeBuffer(MemoryBlock *obj)
 {
     REFLIB_ASSERT_RETURN_IF_FAILED(obj, "Netbuffer is null");
 
-    obj->DestroyMem();
-    _freeBuffers.push(obj);
+    if (!obj->ReleaseRef())
+        return;
+
+    CountFree(obj);
+
+    if (obj->GetSizeClass() == MEMORY_BLOCK_HEAP_CLASS)
+    {
+        obj->DestroyMem();
+        _freeBuffers.push(obj);
+        return;
+    }
+
+    FreeBlock(obj);
+}
+
+void MemoryPool::Grow(MemoryBlock* obj, unsigned int len)
+{
+    REFLIB_ASSERT_RETURN_IF_FAILED(obj, "Netbuffer is null");
+
+    MemoryBlock* bigger = GetBuffer(len, obj->GetTag());
+    if (obj->GetData())
+    {
+        memcpy(bigger->GetData(), obj->GetData(), obj->GetDataLen());
+    }
+
+    // the old payload goes back to its own class with the spare header
+    obj->Swap(*bigger);
+    FreeBuffer(bigger);
+}
+
+// Pooled blocks are counted in the thread cache; heap blocks are rare and go
+// straight to the shared counters.
+void MemoryPool::CountGet(MemoryBlock* obj)
+{
+    int sizeClass = obj->GetSizeClass();
+    if (sizeClass == MEMORY_BLOCK_HEAP_CLASS)
+    {
+        AddInUse(MEMORY_POOL_CLASS_CNT, 1);
+        _tagBlocks[obj->GetTag()].fetch_add(1, std::memory_order_relaxed);
+        _tagBytes[obj->GetTag()].fetch_add(obj->GetCapacity(), std::memory_order_relaxed);
+        return;
+    }
+
+    ++_threadCache._inUse[sizeClass];
+    ++_threadCache._tagBlocks[obj->GetTag()];
+    _threadCache._tagBytes[obj->GetTag()] += obj->GetCapacity();
+
+    if (++_threadCache._unpublished >= MEMORY_POOL_PUBLISH_OPS)
+        PublishStats();
+}
+
+void MemoryPool::CountFree(MemoryBlock* obj)
+{
+    int sizeClass = obj->GetSizeClass();
+    if (sizeClass == MEMORY_BLOCK_HEAP_CLASS)
+    {
+        AddInUse(MEMORY_POOL_CLASS_CNT, -1);
+        _tagBlocks[obj->GetTag()].fetch_sub(1, std::memory_order_relaxed);
+        _tagBytes[obj->GetTag()].fetch_sub(obj->GetCapacity(), std::memory_order_relaxed);
+        return;
+    }
+
+    --_threadCache._inUse[sizeClass];
+    --_threadCache._tagBlocks[obj->GetTag()];
+    _threadCache._tagBytes[obj->GetTag()] -= obj->GetCapacity();
+
+    // frees of other nodes' blocks never trade magazines locally, so the op count
+    // is what keeps a thread that mostly frees remotely from going stale
+    if (++_threadCache._unpublished >= MEMORY_POOL_PUBLISH_OPS)
+        PublishStats();
+}
+
+void MemoryPool::AddInUse(int statIdx, int64 delta)
+{
+    ClassStats& stats = _classStats[statIdx];
+
+    int64 inUse = stats._inUse.fetch_add(delta, std::memory_order_relaxed) + delta;
+    int64 highWater = stats._highWater.load(std::memory_order_relaxed);
+    while (inUse > highWater
+        && !stats._highWater.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed))
+    {
+    }
+}
+
+void MemoryPool::PublishStats()
+{
+    _threadCache._unpublished = 0;
+
+    for (int i = 0; i < MEMORY_POOL_CLASS_CNT; ++i)
+    {
+        if (_threadCache._inUse[i] != 0)
+        {
+            AddInUse(i, _threadCache._inUse[i]);
+            _threadCache._inUse[i] = 0;
+        }
+    }
+
+    for (int i = 0; i < MEMORY_TAG_CNT; ++i)
+    {
+        if (_threadCache._tagBlocks[i] != 0 || _threadCache._tagBytes[i] != 0)
+        {
+            _tagBlocks[i].fetch_add(_threadCache._tagBlocks[i], std::memory_order_relaxed);
+            _tagBytes[i].fetch_add(_threadCache._tagBytes[i], std::memory_order_relaxed);
+            _threadCache._tagBlocks[i] = 0;
+            _threadCache._tagBytes[i] = 0;
+        }
+    }
+}
+
+void MemoryPool::Dump()
+{
+    static const char* tagNames[MEMORY_TAG_CNT] = { "user", "recv", "send", "packet" };
+
+    PublishStats();
+
+    DebugPrint("--Memory pool--");
+    for (int i = 0; i <= MEMORY_POOL_CLASS_CNT; ++i)
+    {
+        const ClassStats& stats = _classStats[i];
+
+        int64 carved = stats._carved.load();
+        if (carved == 0 && stats._highWater.load() == 0)
+            continue;
+
+        int64 inUse = stats._inUse.load();
+        if (i == MEMORY_POOL_CLASS_CNT)
+        {
+            DebugPrint("heap: in use(%lld) high water(%lld)", inUse, stats._highWater.load());
+        }
+        else
+        {
+            DebugPrint("%u bytes: allocated(%lld) in use(%lld) free(%lld) high water(%lld)",
+                GetClassSize(i), carved, inUse, carved - inUse, stats._highWater.load());
+        }
+    }
+
+    for (int i = 0; i < MEMORY_TAG_CNT; ++i)
+    {
+        DebugPrint("outstanding %s: %lld blocks, %lld bytes", tagNames[i], _tagBlocks[i].load(), _tagBytes[i].load());
+    }
 }
 
 } // namespace RefLib
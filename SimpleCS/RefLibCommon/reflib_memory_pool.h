@@ -2,11 +2,29 @@
 
 #include <concurrent_queue.h>
 #include "loki_singleton.h"
+#include "reflib_def.h"
 #include "reflib_memory_block.h"
 
 namespace RefLib
 {
 
+// Fixed-size stack of blocks of one size class, exchanged whole with the depot.
+class MemoryMagazine
+{
+public:
+    MemoryMagazine() : _count(0) {}
+
+    bool IsEmpty() const { return _count == 0; }
+    bool IsFull() const { return _count == MEMORY_POOL_MAGAZINE_SIZE; }
+
+    void Push(MemoryBlock* block) { _blocks[_count++] = block; }
+    MemoryBlock* Pop() { return _blocks[--_count]; }
+
+private:
+    int _count;
+    MemoryBlock* _blocks[MEMORY_POOL_MAGAZINE_SIZE];
+};
+
 class MemoryPool
 {
 public:
@@ -15,13 +33,100 @@ public:
 
     bool Initialize(unsigned int reserve);
 
-    MemoryBlock* GetBuffer(unsigned int bufLen);
+    MemoryBlock* GetBuffer(unsigned int bufLen, MemoryTag tag = MEMORY_TAG_USER);
+
+    // drops one reference; the block returns to the pool with the last one
     void FreeBuffer(MemoryBlock* obj);
 
+    // move obj to a larger payload, keeping its contents
+    void Grow(MemoryBlock* obj, unsigned int len);
+
+    // return the calling thread's cached blocks to the depot
+    void FlushThreadCache();
+
+    // Allocate for the calling thread from the given node from now on.
+    // By default a thread uses the node it first allocated on.
+    void SetThreadNode(int node);
+
+    // Carve slabs for at least count blocks of the size class on the calling
+    // thread's node and touch their pages, so the first gets do not fault.
+    void Prefill(int sizeClass, unsigned int count);
+
+    // Print per-class and per-tag counters. Threads publish their counts every
+    // MEMORY_POOL_PUBLISH_OPS gets and frees, remote frees included, and whenever they
+    // trade magazines with the depot, so each other thread's figures lag by fewer
+    // than MEMORY_POOL_PUBLISH_OPS blocks however long it has been idle.
+    void Dump();
+
+    int64 GetInUseBlocks(MemoryTag tag) const { return _tagBlocks[tag]; }
+    int64 GetInUseBytes(MemoryTag tag) const { return _tagBytes[tag]; }
+
+    // MEMORY_BLOCK_HEAP_CLASS for sizes above the largest class
+    static int GetSizeClass(unsigned int len);
+    static unsigned int GetClassSize(int sizeClass) { return 1u << (sizeClass + MEMORY_POOL_MIN_CLASS_SHIFT); }
+
 private:
     typedef Concurrency::concurrent_queue<MemoryBlock*> CONCURRENT_BUFFERS;
+    typedef Concurrency::concurrent_queue<MemoryMagazine*> CONCURRENT_MAGAZINES;
+
+    // Per-thread loaded and previous magazines for each class of the thread's node.
+    // Gets and frees stay thread local until both magazines run empty or full.
+    // Blocks of other nodes are collected in remote magazines and handed back
+    // to their own node's depot a magazine at a time.
+    struct ThreadCache
+    {
+        ThreadCache();
+        ~ThreadCache();
+
+        int _node;
+        MemoryMagazine* _loaded[MEMORY_POOL_CLASS_CNT];
+        MemoryMagazine* _previous[MEMORY_POOL_CLASS_CNT];
+        MemoryMagazine* _remote[NUMA_MAX_NODE_CNT][MEMORY_POOL_CLASS_CNT];
+
+        // counter deltas not yet published to the pool
+        int64 _inUse[MEMORY_POOL_CLASS_CNT];
+        int64 _tagBlocks[MEMORY_TAG_CNT];
+        int64 _tagBytes[MEMORY_TAG_CNT];
+        int _unpublished;
+    };
+
+    struct ClassStats
+    {
+        ClassStats() : _carved(0), _inUse(0), _highWater(0) {}
+
+        std::atomic<int64> _carved;
+        std::atomic<int64> _inUse;
+        std::atomic<int64> _highWater;
+    };
 
+    MemoryBlock* AllocBlock(int sizeClass);
+    void FreeBlock(MemoryBlock* obj);
+    void FreeRemoteBlock(MemoryBlock* obj);
+
+    int GetThreadNode();
+
+    MemoryMagazine* GetEmptyMagazine();
+    unsigned int CarveSlab(int sizeClass, int node, MemoryMagazine* magazine, bool prefault = false);
+    void ReturnMagazine(int sizeClass, int node, MemoryMagazine* magazine);
+
+    void CountGet(MemoryBlock* obj);
+    void CountFree(MemoryBlock* obj);
+    void PublishStats();
+    void AddInUse(int statIdx, int64 delta);
+
+    static thread_local ThreadCache _threadCache;
+
+    // headers without payload, for the heap path
     CONCURRENT_BUFFERS _freeBuffers;
+
+    // depot: non-empty magazines per node and class, and spare empty magazines
+    CONCURRENT_MAGAZINES _fullMagazines[NUMA_MAX_NODE_CNT][MEMORY_POOL_CLASS_CNT];
+    CONCURRENT_MAGAZINES _emptyMagazines;
+
+    // the last slot counts heap blocks above the largest class
+    ClassStats _classStats[MEMORY_POOL_CLASS_CNT + 1];
+    std::atomic<int64> _tagBlocks[MEMORY_TAG_CNT];
+    std::atomic<int64> _tagBytes[MEMORY_TAG_CNT];
 };
 
 } // namespace RefLib
@@ -0,0 +1,97 @@
+#include "stdafx.h"
+
+#include "reflib_numa.h"
+
+namespace RefLib
+{
+
+int GetNumaNodeCount()
+{
+    static int nodeCnt = 0;
+
+    if (nodeCnt == 0)
+    {
+        ULONG highestNode = 0;
+        if (!GetNumaHighestNodeNumber(&highestNode))
+            highestNode = 0;
+
+        int cnt = static_cast<int>(highestNode) + 1;
+        nodeCnt = (cnt > NUMA_MAX_NODE_CNT) ? NUMA_MAX_NODE_CNT : cnt;
+    }
+
+    return nodeCnt;
+}
+
+int GetCurrentNumaNode()
+{
+    if (GetNumaNodeCount() == 1)
+        return 0;
+
+    PROCESSOR_NUMBER procNumber;
+    GetCurrentProcessorNumberEx(&procNumber);
+
+    USHORT node = 0;
+    if (!GetNumaProcessorNodeEx(&procNumber, &node))
+        return 0;
+
+    return node % NUMA_MAX_NODE_CNT;
+}
+
+bool PinThreadToNumaNode(HANDLE hThread, int node)
+{
+    GROUP_AFFINITY affinity = {};
+    if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity))
+    {
+        DebugPrint("GetNumaNodeProcessorMaskEx failed: %d", GetLastError());
+        return false;
+    }
+
+    if (!SetThreadGroupAffinity(hThread, &affinity, nullptr))
+    {
+        DebugPrint("SetThreadGroupAffinity failed: %d", GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+int GetProcessorCount()
+{
+    static int processorCnt = 0;
+
+    if (processorCnt == 0)
+    {
+        int cnt = static_cast<int>(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS));
+        processorCnt = (cnt > 0) ? cnt : 1;
+    }
+
+    return processorCnt;
+}
+
+bool PinThreadToProcessor(HANDLE hThread, int processor)
+{
+    WORD groupCnt = GetActiveProcessorGroupCount();
+    for (WORD group = 0; group < groupCnt; ++group)
+    {
+        int cnt = static_cast<int>(GetActiveProcessorCount(group));
+        if (processor < cnt)
+        {
+            GROUP_AFFINITY affinity = {};
+            affinity.Group = group;
+            affinity.Mask = static_cast<KAFFINITY>(1) << processor;
+
+            if (!SetThreadGroupAffinity(hThread, &affinity, nullptr))
+            {
+                DebugPrint("SetThreadGroupAffinity failed: %d", GetLastError());
+                return false;
+            }
+            return true;
+        }
+        processor -= cnt;
+    }
+
+    DebugPrint("PinThreadToProcessor: no such processor");
+    return false;
+}
+
+} // namespace RefLib
@@ -0,0 +1,20 @@
+#pragma once
+
+namespace RefLib
+{
+
+// Nodes above NUMA_MAX_NODE_CNT are folded onto the lower ones.
+int GetNumaNodeCount();
+
+// node of the processor the calling thread is running on
+int GetCurrentNumaNode();
+
+bool PinThreadToNumaNode(HANDLE hThread, int node);
+
+// logical processors over all processor groups
+int GetProcessorCount();
+
+// processor counts across groups in order, as GetProcessorCount does
+bool PinThreadToProcessor(HANDLE hThread, int processor);
+
+} // namespace RefLib
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include "reflib_non_copyable.h"
+
+namespace RefLib
+{
+
+// Asserts that state meant to have a single owner is never entered by two threads
+// at once. Compiles to nothing in release builds.
+class OwnerChecker : public NonCopyable
+{
+public:
+    class Scope : public NonCopyable
+    {
+    public:
+        explicit Scope(OwnerChecker &checker) : _checker(checker)
+        {
+            _checker.Enter();
+        }
+        ~Scope()
+        {
+            _checker.Leave();
+        }
+
+    private:
+        OwnerChecker &_checker;
+    };
+
+#ifdef _DEBUG
+    OwnerChecker()
+        : _owner(0)
+        , _depth(0)
+    {
+    }
+
+private:
+    void Enter()
+    {
+        DWORD self = ::GetCurrentThreadId();
+        DWORD expected = 0;
+
+        if (!_owner.compare_exchange_strong(expected, self))
+        {
+            REFLIB_ASSERT(expected == self, "Single owner state is entered by another thread");
+        }
+        ++_depth;
+    }
+
+    void Leave()
+    {
+        if (--_depth == 0)
+            _owner.store(0);
+    }
+
+    std::atomic<DWORD> _owner;
+    uint32 _depth;
+#else
+private:
+    void Enter() {}
+    void Leave() {}
+#endif
+};
+
+} // namespace RefLib
@@ -0,0 +1,267 @@
+#include "stdafx.h"
+
+#include "reflib_def.h"
+#include "reflib_page_arena.h"
+
+namespace RefLib
+{
+
+PageArena::PageArena()
+    : _largePages(false)
+    , _largePageSize(0)
+    , _mappedBytes(0)
+    , _largePageBytes(0)
+    , _usedBytes(0)
+    , _decommittedBytes(0)
+{
+}
+
+PageArena::~PageArena()
+{
+    SafeLock::Owner lock(_lock);
+
+    for (auto& region : _regions)
+    {
+        VirtualFree(region.second.base, 0, MEM_RELEASE);
+    }
+    _regions.clear();
+}
+
+bool PageArena::EnableLargePages()
+{
+    size_t largePageSize = GetLargePageMinimum();
+    if (largePageSize == 0)
+    {
+        DebugPrint("Large pages are not supported.");
+        return false;
+    }
+
+    HANDLE token = nullptr;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+    {
+        DebugPrint("OpenProcessToken failed: %d", GetLastError());
+        return false;
+    }
+
+    TOKEN_PRIVILEGES tp;
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    bool granted = false;
+    if (LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid))
+    {
+        // succeeds even when the privilege is not held, so check the last error
+        AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr);
+        granted = (GetLastError() == ERROR_SUCCESS);
+    }
+    CloseHandle(token);
+
+    if (!granted)
+    {
+        DebugPrint("SeLockMemoryPrivilege is not granted, using normal pages.");
+        return false;
+    }
+
+    SafeLock::Owner lock(_lock);
+
+    _largePageSize = largePageSize;
+    _largePages = true;
+
+    return true;
+}
+
+// Map at least size bytes; size is updated to what was actually mapped.
+char* PageArena::MapRegion(size_t& size, int node)
+{
+    char* base = nullptr;
+    bool large = false;
+    DWORD preferred = (node == NUMA_NODE_ANY) ? NUMA_NO_PREFERRED_NODE : static_cast<DWORD>(node);
+
+    if (_largePages)
+    {
+        size_t largeSize = RoundUp(size, _largePageSize);
+        base = static_cast<char*>(VirtualAllocExNuma(GetCurrentProcess(), nullptr, largeSize,
+            MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, preferred));
+        if (base)
+        {
+            size = largeSize;
+            large = true;
+            _largePageBytes += size;
+        }
+        else
+        {
+            // physical memory is too fragmented for large pages; fall back for this region
+            DebugPrint("Large page allocation of %llu bytes failed: %d", (uint64)largeSize, GetLastError());
+        }
+    }
+
+    if (!base)
+    {
+        size = RoundUp(size, MEMORY_ARENA_ALIGN);
+        base = static_cast<char*>(VirtualAllocExNuma(GetCurrentProcess(), nullptr, size,
+            MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, preferred));
+        if (!base)
+        {
+            DebugPrint("VirtualAlloc of %llu bytes failed: %d", (uint64)size, GetLastError());
+            return nullptr;
+        }
+    }
+
+    Region region = { base, size, large, false };
+    _regions[base] = region;
+    _mappedBytes += size;
+    _heaps[HeapIndex(node)]._mappedBytes += size;
+
+    return base;
+}
+
+void PageArena::UnmapRegion(const Region& region, int node)
+{
+    VirtualFree(region.base, 0, MEM_RELEASE);
+
+    _mappedBytes -= region.size;
+    _heaps[HeapIndex(node)]._mappedBytes -= region.size;
+    if (region.large)
+        _largePageBytes -= region.size;
+
+    _regions.erase(region.base);
+}
+
+PageArena::Region* PageArena::FindRegion(char* data)
+{
+    auto it = _regions.upper_bound(data);
+    if (it == _regions.begin())
+        return nullptr;
+
+    --it;
+    Region& region = it->second;
+    return (data < region.base + region.size) ? &region : nullptr;
+}
+
+char* PageArena::Alloc(size_t len, int node)
+{
+    len = RoundUp(len, MEMORY_ARENA_ALIGN);
+
+    SafeLock::Owner lock(_lock);
+
+    NodeHeap& heap = _heaps[HeapIndex(node)];
+
+    auto it = heap._freeRanges.find(len);
+    if (it != heap._freeRanges.end() && !it->second.empty())
+    {
+        char* data = it->second.back();
+        it->second.pop_back();
+        _usedBytes += len;
+        return data;
+    }
+
+    auto decommitted = heap._decommitted.find(len);
+    if (decommitted != heap._decommitted.end() && !decommitted->second.empty())
+    {
+        char* data = decommitted->second.back();
+        if (VirtualAlloc(data, len, MEM_COMMIT, PAGE_READWRITE))
+        {
+            decommitted->second.pop_back();
+            _decommittedBytes -= len;
+            _usedBytes += len;
+            return data;
+        }
+
+        DebugPrint("VirtualAlloc commit of %llu bytes failed: %d", (uint64)len, GetLastError());
+    }
+
+    if (len > heap._chunkLeft)
+    {
+        // oversized requests get a region of their own
+        if (len > MEMORY_ARENA_CHUNK_SIZE / 2)
+        {
+            size_t size = len;
+            char* data = MapRegion(size, node);
+            if (data)
+            {
+                _regions[data].own = true;
+                _usedBytes += len;
+            }
+            return data;
+        }
+
+        size_t size = MEMORY_ARENA_CHUNK_SIZE;
+        char* chunk = MapRegion(size, node);
+        if (!chunk)
+            return nullptr;
+
+        // keep the tail of the old chunk for a request of its size
+        if (heap._chunkLeft > 0)
+        {
+            heap._freeRanges[heap._chunkLeft].push_back(heap._chunkPos);
+        }
+        heap._chunkPos = chunk;
+        heap._chunkLeft = size;
+    }
+
+    char* data = heap._chunkPos;
+    heap._chunkPos += len;
+    heap._chunkLeft -= len;
+    _usedBytes += len;
+
+    return data;
+}
+
+void PageArena::Free(char* data, size_t len, int node)
+{
+    if (!data)
+        return;
+
+    len = RoundUp(len, MEMORY_ARENA_ALIGN);
+
+    SafeLock::Owner lock(_lock);
+
+    NodeHeap& heap = _heaps[HeapIndex(node)];
+    _usedBytes -= len;
+
+    std::vector<char*>& kept = heap._freeRanges[len];
+    if (kept.size() < MEMORY_ARENA_FREE_KEEP)
+    {
+        kept.push_back(data);
+        return;
+    }
+
+    Region* region = FindRegion(data);
+    if (region && region->own)
+    {
+        UnmapRegion(*region, node);
+        return;
+    }
+
+    if (!region || region->large)
+    {
+        kept.push_back(data);
+        return;
+    }
+
+    // the pages go back to the OS; the range stays reserved for its size
+    if (!VirtualFree(data, len, MEM_DECOMMIT))
+    {
+        DebugPrint("VirtualFree decommit of %llu bytes failed: %d", (uint64)len, GetLastError());
+        kept.push_back(data);
+        return;
+    }
+
+    heap._decommitted[len].push_back(data);
+    _decommittedBytes += len;
+}
+
+void PageArena::PrintStatistics() const
+{
+    DebugPrint("Page arena: used(%llu) mapped(%llu) decommitted(%llu) large pages(%llu bytes, %s)",
+        _usedBytes.load(), _mappedBytes.load(), _decommittedBytes.load(), _largePageBytes.load(),
+        _largePages ? "enabled" : "disabled");
+
+    for (int i = 0; i < NUMA_MAX_NODE_CNT; ++i)
+    {
+        if (_heaps[i]._mappedBytes > 0)
+            DebugPrint("  node %d: mapped(%llu)", i, _heaps[i]._mappedBytes.load());
+    }
+}
+
+} // namespace RefLib
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <vector>
+#include "loki_singleton.h"
+#include "reflib_type_def.h"
+#include "reflib_def.h"
+#include "reflib_non_copyable.h"
+#include "reflib_safelock.h"
+
+namespace RefLib
+{
+
+// Hands out long-lived storage (pool slabs, socket rings) from large
+// VirtualAlloc chunks, backed by large pages when the process may lock memory.
+// Each NUMA node has its own chunks; NUMA_NODE_ANY leaves placement to the OS.
+// A few freed ranges per size stay committed for reuse. Past that, a range
+// with a region of its own is unmapped and any other range on normal pages
+// is decommitted until an Alloc of its size takes it again; large pages
+// cannot be decommitted and are always kept.
+class PageArena : public NonCopyable
+{
+public:
+    PageArena();
+    ~PageArena();
+
+    // Call before the first Alloc. Needs SeLockMemoryPrivilege; returns false
+    // and keeps using normal pages when it is not granted.
+    bool EnableLargePages();
+    bool IsLargePageEnabled() const { return _largePages; }
+
+    // data must be freed with the node it was allocated from
+    char* Alloc(size_t len, int node = NUMA_NODE_ANY);
+    void Free(char* data, size_t len, int node = NUMA_NODE_ANY);
+
+    uint64 GetMappedBytes() const { return _mappedBytes; }
+    uint64 GetMappedBytes(int node) const { return _heaps[HeapIndex(node)]._mappedBytes; }
+    uint64 GetLargePageBytes() const { return _largePageBytes; }
+    uint64 GetUsedBytes() const { return _usedBytes; }
+    uint64 GetDecommittedBytes() const { return _decommittedBytes; }
+
+    void PrintStatistics() const;
+
+private:
+    struct Region
+    {
+        char* base;
+        size_t size;
+        bool large;
+        bool own;       // one oversized allocation
+    };
+
+    struct NodeHeap
+    {
+        NodeHeap() : _chunkPos(nullptr), _chunkLeft(0), _mappedBytes(0) {}
+
+        char* _chunkPos;
+        size_t _chunkLeft;
+        std::map<size_t, std::vector<char*>> _freeRanges;      // committed
+        std::map<size_t, std::vector<char*>> _decommitted;     // reserved only
+        std::atomic<uint64> _mappedBytes;
+    };
+
+    char* MapRegion(size_t& size, int node);
+    void UnmapRegion(const Region& region, int node);
+    // region containing data, null if none
+    Region* FindRegion(char* data);
+
+    static size_t RoundUp(size_t len, size_t align) { return (len + align - 1) / align * align; }
+
+    // the last heap serves NUMA_NODE_ANY
+    static int HeapIndex(int node) { return (node == NUMA_NODE_ANY) ? NUMA_MAX_NODE_CNT : node % NUMA_MAX_NODE_CNT; }
+
+    bool _largePages;
+    size_t _largePageSize;
+
+    std::map<char*, Region> _regions;    // by base
+    NodeHeap _heaps[NUMA_MAX_NODE_CNT + 1];
+    SafeLock _lock;
+
+    std::atomic<uint64> _mappedBytes;
+    std::atomic<uint64> _largePageBytes;
+    std::atomic<uint64> _usedBytes;
+    std::atomic<uint64> _decommittedBytes;
+};
+
+} // namespace RefLib
+
+typedef Loki::SingletonHolder<RefLib::PageArena> PageArenaTypeSingleton;
+#define g_pageArena PageArenaTypeSingleton::Instance()
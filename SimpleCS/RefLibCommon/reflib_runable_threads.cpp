@@ -6,6 +6,7 @@
 #include <assert.h>
 
 #include "reflib_runable_threads.h"
+#include "reflib_numa.h"
 
 #define TIMEOUT_CNT_LIMIT 5
 
@@ -68,6 +69,35 @@ bool RunableThreads::CreateThreads(unsigned threadCnt, unsigned(__stdcall *ExtTh
     return true;
 }
 
+bool RunableThreads::PinToNumaNodes()
+{
+    int nodeCnt = GetNumaNodeCount();
+    if (nodeCnt <= 1)
+        return true;
+
+    int node = 0;
+    for (auto hThread : _hThreads)
+    {
+        if (!PinThreadToNumaNode(hThread, node))
+            return false;
+
+        node = (node + 1) % nodeCnt;
+    }
+
+    return true;
+}
+
+bool RunableThreads::PinToProcessor(int processor)
+{
+    for (auto hThread : _hThreads)
+    {
+        if (!PinThreadToProcessor(hThread, processor))
+            return false;
+    }
+
+    return true;
+}
+
 void RunableThreads::Activate()
 {
     bool expected = false;
@@ -28,6 +28,11 @@ protected:
     bool CreateThreads(unsigned threadCnt);
     bool CreateThreads(unsigned threadCnt, unsigned(__stdcall *ThreadProc)(void *));
 
+    // spread the created threads over NUMA nodes round robin, before Activate
+    bool PinToNumaNodes();
+    // keep every created thread on one processor, before Activate
+    bool PinToProcessor(int processor);
+
     // call by thread
     virtual void Run() {};
 
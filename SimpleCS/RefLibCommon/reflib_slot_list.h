@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include "reflib_type_def.h"
+#include "reflib_def.h"
+
+namespace RefLib
+{
+
+// Lock-free stack of slot indices. Lists built over the same link array can
+// hand a slot to each other, but a slot sits on at most one list at a time.
+// The head carries a tag that changes on every update, so a stale pop fails
+// its CAS instead of corrupting the list.
+class SlotList
+{
+public:
+    SlotList()
+        : _head(MakeHead(SLOT_LIST_END, 0))
+        , _links(nullptr)
+    {
+    }
+
+    void Initialize(std::atomic<uint32>* links) { _links = links; }
+
+    void Push(uint32 slot)
+    {
+        uint64 head = _head.load(std::memory_order_relaxed);
+        uint64 next;
+        do
+        {
+            _links[slot].store(GetSlot(head), std::memory_order_relaxed);
+            next = MakeHead(slot, GetTag(head) + 1);
+        } while (!_head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // SLOT_LIST_END when empty
+    uint32 Pop()
+    {
+        uint64 head = _head.load(std::memory_order_acquire);
+        uint64 next;
+        do
+        {
+            uint32 slot = GetSlot(head);
+            if (slot == SLOT_LIST_END)
+                return SLOT_LIST_END;
+
+            next = MakeHead(_links[slot].load(std::memory_order_relaxed), GetTag(head) + 1);
+        } while (!_head.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire));
+
+        return GetSlot(head);
+    }
+
+    bool IsEmpty() const { return GetSlot(_head.load(std::memory_order_relaxed)) == SLOT_LIST_END; }
+
+private:
+    static uint64 MakeHead(uint32 slot, unsigned int tag)
+    {
+        return (static_cast<uint64>(tag) << 32) | static_cast<unsigned int>(slot);
+    }
+    static uint32 GetSlot(uint64 head) { return static_cast<uint32>(head & 0xFFFFFFFF); }
+    static unsigned int GetTag(uint64 head) { return static_cast<unsigned int>(head >> 32); }
+
+    std::atomic<uint64> _head;
+    std::atomic<uint32>* _links;
+};
+
+} // namespace RefLib
@@ -0,0 +1,103 @@
+#include "stdafx.h"
+
+#include "reflib_tick_arena.h"
+#include "reflib_memory_pool.h"
+
+namespace RefLib
+{
+
+TickArena::TickArena()
+    : _curBlock(0)
+    , _offset(0)
+    , _usedBytes(0)
+    , _highWater(0)
+{
+}
+
+TickArena::~TickArena()
+{
+    // thread_local destruction order is unspecified, so the pool cannot be
+    // touched here; blocks not released by the thread are leaked
+    REFLIB_ASSERT(_blocks.empty() && _largeBlocks.empty(), "TickArena destroyed without Release");
+}
+
+TickArena& TickArena::Current()
+{
+    static thread_local TickArena arena;
+
+    return arena;
+}
+
+void* TickArena::Alloc(size_t len, size_t align)
+{
+    _usedBytes += len;
+    if (_usedBytes > _highWater)
+        _highWater = _usedBytes;
+
+    if (len + align > TICK_ARENA_BLOCK_SIZE)
+    {
+        MemoryBlock* block = g_memoryPool.GetBuffer(static_cast<unsigned int>(len + align));
+        _largeBlocks.push_back(block);
+
+        uintptr_t addr = reinterpret_cast<uintptr_t>(block->GetData());
+        return reinterpret_cast<void*>((addr + align - 1) & ~(align - 1));
+    }
+
+    while (true)
+    {
+        if (_curBlock < _blocks.size())
+        {
+            uintptr_t base = reinterpret_cast<uintptr_t>(_blocks[_curBlock]->GetData());
+            uintptr_t addr = (base + _offset + align - 1) & ~(align - 1);
+
+            if (addr + len <= base + TICK_ARENA_BLOCK_SIZE)
+            {
+                _offset = addr + len - base;
+                return reinterpret_cast<void*>(addr);
+            }
+
+            ++_curBlock;
+            _offset = 0;
+            continue;
+        }
+
+        _blocks.push_back(g_memoryPool.GetBuffer(TICK_ARENA_BLOCK_SIZE));
+    }
+}
+
+char* TickArena::Copy(const char* data, size_t len)
+{
+    char* dest = static_cast<char*>(Alloc(len, 1));
+    memcpy(dest, data, len);
+
+    return dest;
+}
+
+void TickArena::Reset()
+{
+    _curBlock = 0;
+    _offset = 0;
+    _usedBytes = 0;
+
+    if (!_largeBlocks.empty())
+    {
+        for (auto block : _largeBlocks)
+        {
+            g_memoryPool.FreeBuffer(block);
+        }
+        _largeBlocks.clear();
+    }
+}
+
+void TickArena::Release()
+{
+    Reset();
+
+    for (auto block : _blocks)
+    {
+        g_memoryPool.FreeBuffer(block);
+    }
+    _blocks.clear();
+}
+
+} // namespace RefLib
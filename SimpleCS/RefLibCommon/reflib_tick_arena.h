@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <new>
+#include <type_traits>
+#include "reflib_non_copyable.h"
+
+namespace RefLib
+{
+
+class MemoryBlock;
+
+// Bump allocator for data that lives until the end of the current tick.
+// Each logic thread owns one; NetService resets it after every dispatch, so
+// nothing allocated here may be kept past the handler. Send() copies its
+// payload into a pooled packet, so arena memory can be passed to it directly.
+// The owning thread must call Release() before it exits: the pool's thread cache
+// is thread_local too and may already be gone when the arena is destroyed.
+class TickArena : public NonCopyable
+{
+public:
+    TickArena();
+    ~TickArena();
+
+    // arena of the calling thread
+    static TickArena& Current();
+
+    void* Alloc(size_t len, size_t align = alignof(std::max_align_t));
+    char* Copy(const char* data, size_t len);
+
+    // Destructors are never run, so only trivially destructible types are allowed.
+    template<class T, class... Args>
+    T* New(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "TickArena does not run destructors");
+        return new (Alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template<class T>
+    T* NewArray(size_t cnt)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "TickArena does not run destructors");
+        return static_cast<T*>(Alloc(sizeof(T) * cnt, alignof(T)));
+    }
+
+    // Rewind to the first block. Blocks are kept for the next tick; only
+    // oversized allocations go back to the pool.
+    void Reset();
+
+    // Return every block to the pool. Call from the owning thread at its exit.
+    void Release();
+
+    size_t GetUsedBytes() const { return _usedBytes; }
+    size_t GetHighWater() const { return _highWater; }
+
+private:
+    std::vector<MemoryBlock*> _blocks;
+    std::vector<MemoryBlock*> _largeBlocks;
+
+    size_t _curBlock;
+    size_t _offset;
+
+    size_t _usedBytes;
+    size_t _highWater;
+};
+
+} // namespace RefLib
@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "reflib_circular_buffer.h"
 #include <algorithm>
+#include <new>
+#include "reflib_page_arena.h"
 
 namespace RefLib
 {
@@ -10,40 +12,56 @@ CircularBuffer::CircularBuffer(unsigned int size)
     , _headPos(0)
     , _tailPos(0)
 {
-    _buffer = new char[_bufSize];
+    _buffer = g_pageArena.Alloc(_bufSize);
+    if (!_buffer)
+        throw std::bad_alloc();
 }
 
 CircularBuffer::~CircularBuffer()
 {
-    SAFE_DELETE_ARRAY(_buffer);
+    g_pageArena.Free(_buffer, _bufSize);
+    _buffer = nullptr;
 }
 
 bool CircularBuffer::GetData(char *pData, unsigned int len)
+{
+    if (!PeekData(pData, len))
+        return false;
+
+    Skip(len);
+
+    return true;
+}
+
+bool CircularBuffer::PeekData(char *pData, unsigned int len) const
 {
     if (len > Size())
         return false;
 
-    if (_tailPos < _headPos && _headPos + len > _bufSize)
+    unsigned int fc = (std::min)(len, _bufSize - _headPos);
+    memcpy(pData, _buffer + _headPos, fc);
+    if (len > fc)
     {
-        int fc, sc;
-        fc = _bufSize - _headPos;
-        sc = len - fc;
-        memcpy(pData, _buffer + _headPos, fc);
-        if (sc > 0)
-        {
-            memcpy(pData + fc, _buffer, sc);
-        }
+        memcpy(pData + fc, _buffer, len - fc);
     }
-    else
-    {
-        memcpy(pData, _buffer + _headPos, len);
-    }
-
-    _headPos += len;
 
     return true;
 }
 
+void CircularBuffer::Skip(unsigned int len)
+{
+    REFLIB_ASSERT_RETURN_IF_FAILED(len <= Size(), "Cannot skip data: Out of size");
+
+    _headPos = (_headPos + len) % _bufSize;
+}
+
+unsigned int CircularBuffer::GetReadableRegion(const char*& pData) const
+{
+    pData = _buffer + _headPos;
+
+    return (_headPos <= _tailPos) ? (_tailPos - _headPos) : (_bufSize - _headPos);
+}
+
 bool CircularBuffer::PutData(const char *data, unsigned int len)
 {
     REFLIB_ASSERT_RETURN_VAL_IF_FAILED(len > 0 || len <= MAX_PACKET_SIZE,
@@ -102,7 +120,9 @@ void CircularBuffer::SetCapacity(unsigned int size)
     if (size > _bufSize)
     {
         unsigned int prevBufSize = _bufSize;
-        char *newData = new char[size];
+        char *newData = g_pageArena.Alloc(size);
+        if (!newData)
+            throw std::bad_alloc();
 
         if (_headPos == _tailPos)
         {
@@ -121,7 +141,7 @@ void CircularBuffer::SetCapacity(unsigned int size)
         }
         _headPos = 0;
 
-        delete[] _buffer;
+        g_pageArena.Free(_buffer, prevBufSize);
 
         _buffer = newData;
         _bufSize = size;
@@ -23,13 +23,22 @@ public:
     }
 
     bool GetData(char *pData, unsigned int len);
+    bool PeekData(char *pData, unsigned int len) const;
     bool PutData(const char *pData, unsigned int len);
+    void Skip(unsigned int len);
+
+    // contiguous readable bytes starting at the head of the ring.
+    unsigned int GetReadableRegion(const char*& pData) const;
+
+    unsigned int GetCapacity() const { return _bufSize; }
+
+    // touch every page of the storage so the first receive does not fault
+    void Prefault() { memset(_buffer, 0, _bufSize); }
 
 private:
     void PutDataWithoutResize(const char *pData, unsigned int len);
 
     void SetCapacity(unsigned int size);
-    unsigned int GetCapacity() const { return _bufSize; }
 
     unsigned int _bufSize;
     char *_buffer;
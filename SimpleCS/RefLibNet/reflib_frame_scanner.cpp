@@ -0,0 +1,128 @@
+#include "stdafx.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+#include "reflib_frame_scanner.h"
+#include "reflib_packet_header_obj.h"
+
+namespace RefLib
+{
+
+bool FrameScanner::IsAvx2Supported()
+{
+    int info[4] = { 0, };
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // OSXSAVE and AVX, then make sure the OS saves the YMM registers.
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+        return false;
+    if ((_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+
+bool FrameIndex::IsControl(uint32 idx) const
+{
+    return (_headers[idx] & 0xffff) == PACKET_CONTROL_TAG;
+}
+
+FrameScanner::ValidateFn FrameScanner::GetValidator()
+{
+    static const ValidateFn validator = IsAvx2Supported() ? &ValidateAvx2 : &ValidateScalar;
+    return validator;
+}
+
+uint32 FrameScanner::ValidateScalar(const uint32* headers, uint32 cnt)
+{
+    for (uint32 i = 0; i < cnt; ++i)
+    {
+        uint32 tag = headers[i] & 0xffff;
+        if (tag != PACKET_ENVELOP_TAG && tag != PACKET_CONTROL_TAG)
+            return i;
+        if ((headers[i] >> 16) > MAX_PACKET_CONTENT_SIZE)
+            return i;
+    }
+    return cnt;
+}
+
+uint32 FrameScanner::ValidateAvx2(const uint32* headers, uint32 cnt)
+{
+    const __m256i tagMask = _mm256_set1_epi32(0xffff);
+    const __m256i envTag = _mm256_set1_epi32(PACKET_ENVELOP_TAG);
+    const __m256i controlTag = _mm256_set1_epi32(PACKET_CONTROL_TAG);
+    const __m256i maxLen = _mm256_set1_epi32(MAX_PACKET_CONTENT_SIZE);
+
+    uint32 i = 0;
+    for (; i + 8 <= cnt; i += 8)
+    {
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(headers + i));
+
+        __m256i tag = _mm256_and_si256(h, tagMask);
+        __m256i tagOk = _mm256_or_si256(_mm256_cmpeq_epi32(tag, envTag), _mm256_cmpeq_epi32(tag, controlTag));
+        __m256i lenBad = _mm256_cmpgt_epi32(_mm256_srli_epi32(h, 16), maxLen);
+
+        // one bit per header: tag mismatch or oversized content
+        int badMask = ~_mm256_movemask_ps(_mm256_castsi256_ps(tagOk)) & 0xff;
+        badMask |= _mm256_movemask_ps(_mm256_castsi256_ps(lenBad));
+        if (badMask)
+        {
+            unsigned long pos = 0;
+            _BitScanForward(&pos, static_cast<unsigned long>(badMask));
+            return i + pos;
+        }
+    }
+
+    return i + ValidateScalar(headers + i, cnt - i);
+}
+
+bool FrameScanner::Scan(const char* data, uint32 len, FrameIndex& index)
+{
+    index.Clear();
+
+    uint32 pos = 0;
+    uint32 headerCnt = 0;
+
+    // Each offset depends on the previous length, so the walk stays scalar
+    // and only records raw header words. Validation runs on them afterwards in bulk.
+    while (index._count < MAX_FRAME_BATCH_COUNT && pos + PACKET_HEADER_SIZE <= len)
+    {
+        uint32 header;
+        memcpy(&header, data + pos, sizeof(header));
+        index._headers[index._count] = header;
+        headerCnt = index._count + 1;
+
+        uint32 frameLen = PACKET_HEADER_SIZE + (header >> 16);
+        if (pos + frameLen > len)
+            break;
+
+        index._offsets[index._count] = pos + PACKET_HEADER_SIZE;
+        index._count++;
+        pos += frameLen;
+    }
+
+    // The header of a trailing incomplete frame is validated as well,
+    // so a corrupted stream is caught before its bogus length is waited for.
+    uint32 validCnt = GetValidator()(index._headers, headerCnt);
+    if (validCnt < headerCnt)
+    {
+        index._corrupted = true;
+        if (validCnt < index._count)
+            index._count = validCnt;
+    }
+
+    if (index._count > 0)
+    {
+        uint32 last = index._count - 1;
+        index._scannedLen = index._offsets[last] + index.GetContentLen(last);
+    }
+
+    return !index._corrupted;
+}
+
+} // namespace RefLib
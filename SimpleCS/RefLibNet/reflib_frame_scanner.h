@@ -0,0 +1,61 @@
+#pragma once
+
+#include "reflib_type_def.h"
+#include "reflib_net_def.h"
+
+namespace RefLib
+{
+
+class FrameIndex
+{
+public:
+    FrameIndex() { Clear(); }
+
+    void Clear()
+    {
+        _count = 0;
+        _scannedLen = 0;
+        _corrupted = false;
+    }
+
+    uint32 Count() const { return _count; }
+    uint32 GetScannedLen() const { return _scannedLen; }
+    bool IsCorrupted() const { return _corrupted; }
+
+    // offset of the frame content from the start of the scanned region.
+    uint32 GetOffset(uint32 idx) const { return _offsets[idx]; }
+    uint16 GetContentLen(uint32 idx) const { return static_cast<uint16>(_headers[idx] >> 16); }
+    bool IsControl(uint32 idx) const;
+
+private:
+    friend class FrameScanner;
+
+    // raw header words, laid out as PacketHeaderObj::HeaderVal (envTag | contentLen << 16).
+    uint32 _headers[MAX_FRAME_BATCH_COUNT];
+    uint32 _offsets[MAX_FRAME_BATCH_COUNT];
+    uint32 _count;
+    uint32 _scannedLen;
+    bool _corrupted;
+};
+
+class FrameScanner
+{
+public:
+    typedef uint32 (*ValidateFn)(const uint32* headers, uint32 cnt);
+
+    // Index every complete frame in [data, data + len).
+    // Returns false when a header with a bad envelop tag or length is found;
+    // the frames before it are still indexed.
+    static bool Scan(const char* data, uint32 len, FrameIndex& index);
+
+    static bool IsAvx2Supported();
+
+    // Return the position of the first invalid header, or cnt if all are valid.
+    static uint32 ValidateScalar(const uint32* headers, uint32 cnt);
+    static uint32 ValidateAvx2(const uint32* headers, uint32 cnt);
+
+private:
+    static ValidateFn GetValidator();
+};
+
+} // namespace RefLib
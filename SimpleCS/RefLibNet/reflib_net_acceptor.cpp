@@ -7,9 +7,8 @@
 namespace RefLib
 {
 
-NetAcceptor::NetAcceptor(NetSocketBase* sock, HANDLE compPort)
+NetAcceptor::NetAcceptor(NetSocketBase* sock)
     : _listenSock(sock)
-    , _comPort(compPort)
 {
 }
 
@@ -45,12 +44,14 @@ bool NetAcceptor::PostAccept(AcceptBuffer* acceptObj)
     }
 
     acceptObj->Reset(sClient);
+    _listenSock->AddIoRef();
 
     if (g_network.Accept(_listenSock->GetSocket(), acceptObj) == false)
     {
         if (WSAGetLastError() != WSA_IO_PENDING)
         {
             DebugPrint("AcceptEx failed: %s", SocketGetLastErrorString().c_str());
+            _listenSock->ReleaseIoRef();
             return false;
         }
 
@@ -60,22 +61,22 @@ bool NetAcceptor::PostAccept(AcceptBuffer* acceptObj)
     return true;
 }
 
-void NetAcceptor::OnAccept(std::weak_ptr<NetConnection> clientObj, NetCompletionOP* bufObj)
+bool NetAcceptor::OnAccept(std::weak_ptr<NetConnection> clientObj, NetCompletionOP* bufObj, HANDLE comPort)
 {
     auto con = clientObj.lock();
     if (!con.get())
-        return;
+        return false;
 
     // Associate the new connection to our completion port
     HANDLE hrc = CreateIoCompletionPort(
         (HANDLE)bufObj->client,
-        _comPort,
+        comPort,
         (ULONG_PTR)con.get(),
         0);
     if (hrc == NULL)
     {
         DebugPrint("OnAccept failed: %s", SocketGetLastErrorString().c_str());
-        return;
+        return false;
     }
 
     con->OnConnected();
@@ -83,6 +84,16 @@ void NetAcceptor::OnAccept(std::weak_ptr<NetConnection> clientObj, NetCompletion
     // Re-post the AcceptEx
     AcceptBuffer* acceptObj = reinterpret_cast<AcceptBuffer*>(bufObj);
     PostAccept(acceptObj);
+
+    return true;
+}
+
+void NetAcceptor::Reject(NetCompletionOP* bufObj)
+{
+    closesocket(bufObj->client);
+
+    AcceptBuffer* acceptObj = reinterpret_cast<AcceptBuffer*>(bufObj);
+    PostAccept(acceptObj);
 }
 
 } // namespace RefLib
\ No newline at end of file
@@ -38,18 +38,21 @@ private:
 class NetAcceptor
 {
 public:
-    NetAcceptor(NetSocketBase* sock, HANDLE compPort);
+    explicit NetAcceptor(NetSocketBase* sock);
     ~NetAcceptor();
 
     void Accepts();
-    void OnAccept(std::weak_ptr<NetConnection> clientobj, NetCompletionOP* bufObj);
+    // comPort is the one the accepted socket's completions go to. On false the
+    // socket could not be associated; the caller releases the connection and rejects.
+    bool OnAccept(std::weak_ptr<NetConnection> clientobj, NetCompletionOP* bufObj, HANDLE comPort);
+    // close the accepted socket and put the accept back in flight
+    void Reject(NetCompletionOP* bufObj);
 
 private:
     bool PostAccept(AcceptBuffer* acceptObj);
 
     std::vector<AcceptBuffer*> _pendingAccepts;
     NetSocketBase* _listenSock;
-    HANDLE _comPort;
 };
 
 } // namespace RefLib
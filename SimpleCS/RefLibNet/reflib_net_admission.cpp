@@ -0,0 +1,164 @@
+#include "stdafx.h"
+
+#include "reflib_net_admission.h"
+
+namespace RefLib
+{
+
+NetAdmissionTable::NetAdmissionTable()
+    : _mask(0)
+    , _admitted(0)
+{
+    for (auto& rejects : _rejects)
+        rejects = 0;
+}
+
+bool NetAdmissionTable::Initialize(const NetAdmissionPolicy& policy)
+{
+    SafeLock::Owner lock(_lock);
+
+    _entries.reset();
+    _policy = policy;
+
+    if (!policy.IsEnabled())
+        return true;
+
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(policy.tableSize > 0 && (policy.tableSize & (policy.tableSize - 1)) == 0,
+        "Admission table size must be a power of two", false);
+
+    _entries.reset(new Entry[policy.tableSize]);
+    memset(_entries.get(), 0, sizeof(Entry) * policy.tableSize);
+    _mask = policy.tableSize - 1;
+
+    return true;
+}
+
+// must hold _lock
+void NetAdmissionTable::Refill(Entry& entry, uint64 now) const
+{
+    if (_policy.connectsPerSec == 0)
+        return;
+
+    uint64 capacity = static_cast<uint64>(_policy.connectBurst) * 1000;
+    uint64 tokens = entry.milliTokens + (now - entry.lastTick) * _policy.connectsPerSec;
+
+    entry.milliTokens = static_cast<uint32>(tokens < capacity ? tokens : capacity);
+}
+
+// must hold _lock
+bool NetAdmissionTable::IsStale(const Entry& entry, uint64 now) const
+{
+    if (entry.concurrent > 0)
+        return false;
+    if (_policy.connectsPerSec == 0)
+        return true;
+
+    uint64 refillMsec = static_cast<uint64>(_policy.connectBurst) * 1000 / _policy.connectsPerSec;
+    return now - entry.lastTick >= refillMsec;
+}
+
+// must hold _lock
+NetAdmissionTable::Entry* NetAdmissionTable::Find(uint32 addr, uint64 now, bool insert)
+{
+    // Fibonacci hashing spreads neighbouring addresses
+    uint32 pos = static_cast<uint32>((static_cast<unsigned int>(addr) * 2654435769u) & _mask);
+    Entry* reusable = nullptr;
+
+    for (uint32 i = 0; i < NET_ADMISSION_MAX_PROBE; ++i)
+    {
+        Entry& entry = _entries[(pos + i) & _mask];
+
+        if (entry.addr == addr)
+            return &entry;
+
+        // probe chains only end at a slot that was never used
+        if (entry.addr == 0)
+        {
+            if (!reusable)
+                reusable = &entry;
+            break;
+        }
+
+        if (!reusable && IsStale(entry, now))
+            reusable = &entry;
+    }
+
+    if (!insert || !reusable)
+        return nullptr;
+
+    reusable->addr = addr;
+    reusable->milliTokens = _policy.connectBurst * 1000;
+    reusable->concurrent = 0;
+    reusable->lastTick = now;
+
+    return reusable;
+}
+
+NetAdmitResult NetAdmissionTable::Admit(uint32 addr, uint64 now)
+{
+    if (!_entries)
+        return NET_ADMIT_OK;
+
+    NetAdmitResult result = NET_ADMIT_OK;
+    {
+        SafeLock::Owner lock(_lock);
+
+        Entry* entry = Find(addr, now, true);
+        if (!entry)
+        {
+            result = NET_ADMIT_REJECT_TABLE_FULL;
+        }
+        else
+        {
+            Refill(*entry, now);
+            entry->lastTick = now;
+
+            if (_policy.maxPerAddr > 0 && entry->concurrent >= _policy.maxPerAddr)
+            {
+                result = NET_ADMIT_REJECT_CONCURRENT;
+            }
+            else if (_policy.connectsPerSec > 0 && entry->milliTokens < 1000)
+            {
+                result = NET_ADMIT_REJECT_RATE;
+            }
+            else
+            {
+                if (_policy.connectsPerSec > 0)
+                    entry->milliTokens -= 1000;
+                ++entry->concurrent;
+            }
+        }
+    }
+
+    if (result == NET_ADMIT_OK)
+        _admitted.fetch_add(1);
+    else
+        OnReject(result);
+
+    return result;
+}
+
+void NetAdmissionTable::Release(uint32 addr)
+{
+    if (!_entries)
+        return;
+
+    SafeLock::Owner lock(_lock);
+
+    Entry* entry = Find(addr, 0, false);
+    if (entry && entry->concurrent > 0)
+        --entry->concurrent;
+}
+
+void NetAdmissionTable::PrintStatistics()
+{
+    DebugPrint("Admission: admitted(%llu) rejected rate(%llu) concurrent(%llu) table full(%llu) no conn(%llu) no addr(%llu)",
+        _admitted.load(),
+        _rejects[NET_ADMIT_REJECT_RATE].load(),
+        _rejects[NET_ADMIT_REJECT_CONCURRENT].load(),
+        _rejects[NET_ADMIT_REJECT_TABLE_FULL].load(),
+        _rejects[NET_ADMIT_REJECT_NO_CONN].load(),
+        _rejects[NET_ADMIT_REJECT_NO_ADDR].load());
+}
+
+} // namespace RefLib
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include "reflib_type_def.h"
+#include "reflib_net_def.h"
+#include "reflib_safelock.h"
+
+namespace RefLib
+{
+
+struct NetAdmissionPolicy
+{
+    NetAdmissionPolicy()
+        : connectsPerSec(0)
+        , connectBurst(10)
+        , maxPerAddr(0)
+        , tableSize(NET_ADMISSION_TABLE_SIZE)
+    {
+    }
+
+    bool IsEnabled() const { return connectsPerSec > 0 || maxPerAddr > 0; }
+
+    uint32 connectsPerSec;  // 0 disables the rate limit
+    uint32 connectBurst;    // connects allowed back to back
+    uint32 maxPerAddr;      // concurrent connections per address; 0 disables
+    uint32 tableSize;       // tracked addresses, power of two
+};
+
+// Per source IPv4 address connect rate and concurrency, checked at accept
+// time before any connection state is taken. Open addressing with a bounded
+// probe; an entry is reused once it holds no connection and its bucket has
+// refilled, so forgetting it loses nothing.
+class NetAdmissionTable
+{
+public:
+    NetAdmissionTable();
+
+    bool Initialize(const NetAdmissionPolicy& policy);
+    bool IsEnabled() const { return _entries != nullptr; }
+
+    NetAdmitResult Admit(uint32 addr, uint64 now);
+    // undo one admitted connection of addr
+    void Release(uint32 addr);
+
+    void OnReject(NetAdmitResult reason) { _rejects[reason].fetch_add(1); }
+    uint64 GetRejects(NetAdmitResult reason) const { return _rejects[reason]; }
+    uint64 GetAdmitted() const { return _admitted; }
+
+    void PrintStatistics();
+
+private:
+    struct Entry
+    {
+        uint32 addr;            // 0 for a slot never used
+        uint32 milliTokens;
+        uint32 concurrent;
+        uint64 lastTick;
+    };
+
+    Entry* Find(uint32 addr, uint64 now, bool insert);
+    bool IsStale(const Entry& entry, uint64 now) const;
+    void Refill(Entry& entry, uint64 now) const;
+
+    NetAdmissionPolicy _policy;
+    std::unique_ptr<Entry[]> _entries;
+    uint32 _mask;
+    SafeLock _lock;
+
+    std::atomic<uint64> _admitted;
+    std::atomic<uint64> _rejects[NET_ADMIT_RESULT_CNT];
+};
+
+} // namespace RefLib
@@ -0,0 +1,191 @@
+#include "stdafx.h"
+
+#include "reflib_net_affinity.h"
+#include "reflib_net_service.h"
+#include "reflib_numa.h"
+#include "reflib_tick_arena.h"
+
+namespace RefLib
+{
+
+/////////////////////////////////////////////////////////////////////
+// NetLogicWorker
+
+bool NetLogicWorker::Initialize(HANDLE comPort, uint32 concurrency, int processor)
+{
+    _comPort = comPort;
+
+    if (!CreateThreads(concurrency))
+        return false;
+
+    if (processor >= 0)
+        PinToProcessor(processor);
+
+    RunableThreads::Activate();
+
+    return true;
+}
+
+unsigned NetLogicWorker::RunByThread()
+{
+    unsigned rc = RunableThreads::RunByThread();
+
+    // while this thread's pool cache is still alive
+    TickArena::Current().Release();
+
+    return rc;
+}
+
+void NetLogicWorker::Run()
+{
+    NetService::DispatchPackets(_comPort);
+}
+
+/////////////////////////////////////////////////////////////////////
+// NetShard
+
+NetShard::NetShard(uint32 index)
+    : _index(index)
+    , _ioPort(nullptr)
+    , _logicPort(nullptr)
+    , _io(nullptr)
+    , _load(0)
+    , _assigned(0)
+{
+}
+
+NetShard::~NetShard()
+{
+    if (_ioPort)
+        CloseHandle(_ioPort);
+    if (_logicPort)
+        CloseHandle(_logicPort);
+}
+
+bool NetShard::Initialize(uint32 concurrency, int processor)
+{
+    _ioPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, (ULONG_PTR)nullptr, concurrency);
+    _logicPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, (ULONG_PTR)nullptr, concurrency);
+    if (!_ioPort || !_logicPort)
+    {
+        DebugPrint("CreateIoCompletionPort failed: %d", GetLastError());
+        return false;
+    }
+
+    return _io.Initialize(_ioPort, concurrency, processor)
+        && _logic.Initialize(_logicPort, concurrency, processor);
+}
+
+void NetShard::Shutdown()
+{
+    _io.Deactivate();
+    _logic.Deactivate();
+
+    _io.Join();
+    _logic.Join();
+}
+
+void NetShard::PrintStatistics()
+{
+    DebugPrint("Shard(%d): connections(%d) assigned(%llu)", _index, _load.load(), _assigned.load());
+    _io.GetTimerWheel().PrintStatistics();
+}
+
+/////////////////////////////////////////////////////////////////////
+// NetAffinity
+
+NetAffinity::NetAffinity()
+    : _rebalanced(0)
+{
+}
+
+NetAffinity::~NetAffinity()
+{
+}
+
+bool NetAffinity::Initialize(const NetAffinityPolicy& policy)
+{
+    _policy = policy;
+    if (_policy.shards == 0)
+        return true;
+
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(_shards.empty(), "NetAffinity: already initialized", false);
+
+    uint32 concurrency = (_policy.threadsPerShard > 0) ? _policy.threadsPerShard : 1;
+
+    for (uint32 i = 0; i < _policy.shards; ++i)
+    {
+        int processor = _policy.pinThreads ? static_cast<int>(i % GetProcessorCount()) : -1;
+
+        auto shard = std::make_unique<NetShard>(i);
+        if (!shard->Initialize(concurrency, processor))
+        {
+            shard->Shutdown();
+            Shutdown();
+            return false;
+        }
+
+        _shards.push_back(std::move(shard));
+    }
+
+    return true;
+}
+
+void NetAffinity::Shutdown()
+{
+    for (auto& shard : _shards)
+        shard->Shutdown();
+
+    _shards.clear();
+}
+
+NetShard* NetAffinity::Assign(uint32 slot)
+{
+    if (_shards.empty())
+        return nullptr;
+
+    uint32 cnt = static_cast<uint32>(_shards.size());
+    NetShard* home = _shards[slot % cnt].get();
+    uint32 homeLoad = home->GetLoad();
+
+    NetShard* least = home;
+    uint32 leastLoad = homeLoad;
+    uint32 total = 0;
+
+    for (auto& shard : _shards)
+    {
+        uint32 load = shard->GetLoad();
+        total += load;
+        if (load < leastLoad)
+        {
+            least = shard.get();
+            leastLoad = load;
+        }
+    }
+
+    // loads are read without a lock; an approximate average is enough to steer
+    uint32 limit = (total / cnt + 1) * _policy.overloadPercent / 100;
+
+    NetShard* chosen = home;
+    if (homeLoad >= limit && least != home)
+    {
+        chosen = least;
+        ++_rebalanced;
+    }
+
+    chosen->Acquire();
+    return chosen;
+}
+
+void NetAffinity::PrintStatistics()
+{
+    if (_shards.empty())
+        return;
+
+    DebugPrint("Affinity: shards(%d) rebalanced(%llu)", static_cast<uint32>(_shards.size()), _rebalanced.load());
+
+    for (auto& shard : _shards)
+        shard->PrintStatistics();
+}
+
+} // namespace RefLib
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <memory>
+#include <atomic>
+#include <vector>
+#include "reflib_type_def.h"
+#include "reflib_net_worker.h"
+
+namespace RefLib
+{
+
+struct NetAffinityPolicy
+{
+    NetAffinityPolicy()
+        : shards(0)
+        , threadsPerShard(1)
+        , overloadPercent(150)
+        , pinThreads(true)
+    {
+    }
+
+    uint32 shards;              // 0 disables affinity
+    uint32 threadsPerShard;     // I/O threads, and as many logic threads
+    uint32 overloadPercent;     // of the average load; a slot's shard above it is passed over
+    bool pinThreads;            // keep shard n's threads on processor n
+};
+
+// Logic threads of one shard; they run NetObj::OnRecvPacket like the service's own.
+class NetLogicWorker : public RunableThreads
+{
+public:
+    NetLogicWorker() : _comPort(nullptr) {}
+
+    bool Initialize(HANDLE comPort, uint32 concurrency, int processor);
+
+    virtual unsigned RunByThread() override;
+
+protected:
+    virtual void Run() override;
+
+private:
+    HANDLE _comPort;
+};
+
+// A connection's socket completions and its NetObj's packets are both queued
+// to the ports of its shard, so one small set of threads on one processor
+// touches the connection's state.
+class NetShard
+{
+public:
+    explicit NetShard(uint32 index);
+    ~NetShard();
+
+    bool Initialize(uint32 concurrency, int processor);
+    void Shutdown();
+
+    uint32 GetIndex() const { return _index; }
+    HANDLE GetIOPort() const { return _ioPort; }
+    HANDLE GetLogicPort() const { return _logicPort; }
+    // deadlines of the shard's connections, advanced by its I/O threads
+    NetTimerWheel& GetTimerWheel() { return _io.GetTimerWheel(); }
+
+    uint32 GetLoad() const { return _load; }
+    void Acquire() { ++_load; ++_assigned; }
+    void Release() { --_load; }
+
+    void PrintStatistics();
+
+private:
+    uint32 _index;
+    HANDLE _ioPort;
+    HANDLE _logicPort;
+    NetWorker _io;
+    NetLogicWorker _logic;
+
+    std::atomic<uint32> _load;      // live connections
+    std::atomic<uint64> _assigned;
+};
+
+// Picks a shard for each connection by its CompositId slot. A connection
+// stays on its shard for its lifetime, since a socket cannot leave the
+// completion port it was associated with; new connections are steered to
+// the least loaded shard while the slot's own shard is overloaded.
+class NetAffinity
+{
+public:
+    NetAffinity();
+    ~NetAffinity();
+
+    bool Initialize(const NetAffinityPolicy& policy);
+    void Shutdown();
+
+    bool IsEnabled() const { return !_shards.empty(); }
+
+    // null without affinity
+    NetShard* Assign(uint32 slot);
+
+    void PrintStatistics();
+
+private:
+    NetAffinityPolicy _policy;
+    std::vector<std::unique_ptr<NetShard>> _shards;
+    std::atomic<uint64> _rebalanced;
+};
+
+} // namespace RefLib
@@ -191,6 +191,84 @@ bool NetworkAPI::Accept(SOCKET listenSock, AcceptBuffer* acceptObj)
         ) == TRUE);
 }
 
+// Remote address of a completed AcceptEx, read from its address buffer.
+bool NetworkAPI::GetAcceptAddr(AcceptBuffer* acceptObj, SOCKADDR_IN& remote)
+{
+    sockaddr* localAddr = nullptr;
+    sockaddr* remoteAddr = nullptr;
+    int localLen = 0;
+    int remoteLen = 0;
+
+    _lpfnGetAcceptExSockaddrs(
+        acceptObj->GetData(),
+        0,
+        SOCKETADDR_BUFFER_SIZE,
+        SOCKETADDR_BUFFER_SIZE,
+        &localAddr,
+        &localLen,
+        &remoteAddr,
+        &remoteLen);
+
+    if (!remoteAddr || remoteAddr->sa_family != AF_INET || remoteLen < static_cast<int>(sizeof(SOCKADDR_IN)))
+        return false;
+
+    memcpy(&remote, remoteAddr, sizeof(SOCKADDR_IN));
+    return true;
+}
+
+bool NetworkAPI::DuplicateSocket(SOCKET sock, DWORD targetPid, WSAPROTOCOL_INFOW& info)
+{
+    if (WSADuplicateSocketW(sock, targetPid, &info) == SOCKET_ERROR)
+    {
+        DebugPrint("WSADuplicateSocket failed: %s", SocketGetLastErrorString().c_str());
+        return false;
+    }
+    return true;
+}
+
+SOCKET NetworkAPI::AdoptSocket(WSAPROTOCOL_INFOW& info)
+{
+    SOCKET sock = WSASocketW(FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO,
+        &info, 0, WSA_FLAG_OVERLAPPED);
+    if (sock == INVALID_SOCKET)
+    {
+        DebugPrint("WSASocket from protocol info failed: %s", SocketGetLastErrorString().c_str());
+    }
+    return sock;
+}
+
+// A duplicated socket shares its file object with the original, and so the
+// completion port association made by the previous process. Replace it.
+bool NetworkAPI::AssociateAdopted(SOCKET sock, HANDLE comPort, ULONG_PTR key)
+{
+    if (CreateIoCompletionPort((HANDLE)sock, comPort, key, 0))
+        return true;
+
+    if (GetLastError() != ERROR_INVALID_PARAMETER)
+    {
+        DebugPrint("CreateIoCompletionPort failed: %d", GetLastError());
+        return false;
+    }
+
+    // FileReplaceCompletionInformation, Windows 8.1 and later
+    typedef LONG (WINAPI *NtSetInformationFileFn)(HANDLE, PVOID, PVOID, ULONG, int);
+    static const NtSetInformationFileFn setInformationFile = reinterpret_cast<NtSetInformationFileFn>(
+        GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtSetInformationFile"));
+    const int FileReplaceCompletionInformation = 61;
+
+    struct { HANDLE port; PVOID key; } completion = { comPort, reinterpret_cast<PVOID>(key) };
+    struct { PVOID status; ULONG_PTR information; } ioStatus = { nullptr, 0 };
+
+    if (!setInformationFile
+        || setInformationFile((HANDLE)sock, &ioStatus, &completion, sizeof(completion), FileReplaceCompletionInformation) < 0)
+    {
+        DebugPrint("Cannot move adopted socket(%d) to this completion port", sock);
+        return false;
+    }
+
+    return true;
+}
+
 bool NetworkAPI::Connect(NetCompletionOP* bufObj, const SOCKADDR_IN& addr)
 {
     SOCKET socket = bufObj->client;
@@ -209,16 +287,22 @@ bool NetworkAPI::Connect(NetCompletionOP* bufObj, const SOCKADDR_IN& addr)
         return false;
     }
 
-    ConnectEx(bufObj, addr);
-
-    return true;
+    return ConnectEx(bufObj, addr);
 }
 
-void NetworkAPI::ConnectEx(NetCompletionOP* bufObj, const SOCKADDR_IN& addr)
+// No completion is queued when ConnectEx fails right away.
+bool NetworkAPI::ConnectEx(NetCompletionOP* bufObj, const SOCKADDR_IN& addr)
 {
     SOCKET socket = bufObj->client;
 
-    _lpfnConnectEx(socket, (SOCKADDR*)&addr, sizeof(addr), nullptr, 0, nullptr, &(bufObj->ol));
+    if (!_lpfnConnectEx(socket, (SOCKADDR*)&addr, sizeof(addr), nullptr, 0, nullptr, &(bufObj->ol))
+        && WSAGetLastError() != WSA_IO_PENDING)
+    {
+        DebugPrint("ConnectEx failed: %s", SocketGetLastErrorString().c_str());
+        return false;
+    }
+
+    return true;
 }
 
 bool NetworkAPI::Disconnect(NetCompletionOP* bufObj, NetCloseType closer)
@@ -228,25 +312,32 @@ bool NetworkAPI::Disconnect(NetCompletionOP* bufObj, NetCloseType closer)
     if (socket == INVALID_SOCKET)
         return false;
 
+    bool queued = false;
+
     if (closer == NET_CTYPE_SHUTDOWN)
     {
         shutdown(socket, SD_BOTH);
         closesocket(socket);
     }
+    else if (closer == NET_CTYPE_HANDOFF)
+    {
+        // shutdown or DisconnectEx would end the connection for the new owner too
+        closesocket(socket);
+    }
     else
     {
-        DisconnectEx(bufObj);
+        queued = DisconnectEx(bufObj);
         closesocket(socket);
     }
 
-    return true;
+    return queued;
 }
 
-void NetworkAPI::DisconnectEx(NetCompletionOP* bufObj)
+bool NetworkAPI::DisconnectEx(NetCompletionOP* bufObj)
 {
     SOCKET socket = bufObj->client;
 
-    _lpfnDisconnectEx(socket, &(bufObj->ol), 0, 0);
+    return _lpfnDisconnectEx(socket, &(bufObj->ol), 0, 0) || WSAGetLastError() == WSA_IO_PENDING;
 }
 
 } // namespace RefLib
\ No newline at end of file
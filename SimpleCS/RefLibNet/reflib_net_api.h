@@ -21,13 +21,20 @@ public:
 
     bool Listen(SOCKET listenSock, const SOCKADDR_IN& saLocal);
     bool Accept(SOCKET listenSock, AcceptBuffer* acceptObj);
+    bool GetAcceptAddr(AcceptBuffer* acceptObj, SOCKADDR_IN& remote);
     bool Connect(NetCompletionOP* bufObj, const SOCKADDR_IN& addr);
+    // true if a completion is queued for bufObj
     bool Disconnect(NetCompletionOP* bufObj, NetCloseType closer);
 
+    // hot restart: hand a socket to another process and take it over there
+    bool DuplicateSocket(SOCKET sock, DWORD targetPid, WSAPROTOCOL_INFOW& info);
+    SOCKET AdoptSocket(WSAPROTOCOL_INFOW& info);
+    bool AssociateAdopted(SOCKET sock, HANDLE comPort, ULONG_PTR key);
+
 private:
     bool InitNetworkExFns();
-    void ConnectEx(NetCompletionOP* bufObj, const SOCKADDR_IN& addr);
-    void DisconnectEx(NetCompletionOP* bufObj);
+    bool ConnectEx(NetCompletionOP* bufObj, const SOCKADDR_IN& addr);
+    bool DisconnectEx(NetCompletionOP* bufObj);
 
     LPFN_ACCEPTEX               _lpfnAcceptEx;
     LPFN_GETACCEPTEXSOCKADDRS   _lpfnGetAcceptExSockaddrs;
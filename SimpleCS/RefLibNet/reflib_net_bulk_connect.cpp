@@ -0,0 +1,202 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include "reflib_net_bulk_connect.h"
+#include "reflib_net_service.h"
+#include "reflib_net_heartbeat.h"
+
+namespace RefLib
+{
+
+NetBulkConnect::NetBulkConnect(NetClientService* service, const SOCKADDR_IN& addr, uint32 count,
+    NetBulkObjFactory factory, const NetBulkConnectPolicy& policy, const NetBulkConnectCallbacks& callbacks)
+    : _service(service)
+    , _addr(addr)
+    , _count(count)
+    , _factory(factory)
+    , _policy(policy)
+    , _callbacks(callbacks)
+    , _objs(count)
+    , _launchUsec(count, 0)
+    , _latencyUsec(count, 0)
+    , _results(count, NET_CONNECT_RESULT_CNT)
+    , _next(0)
+    , _finished(0)
+    , _outstanding(count)
+    , _connected(0)
+    , _failed(0)
+    , _cancelled(0)
+    , _cancelRequested(false)
+    , _startTick(GetTickCount64())
+    , _endTick(0)
+{
+    if (_policy.maxPending == 0)
+        _policy.maxPending = 1;
+
+    _doneEvent = CreateEventW(nullptr, TRUE, count == 0, nullptr);
+}
+
+NetBulkConnect::~NetBulkConnect()
+{
+    Cancel();
+    Wait(INFINITE);
+
+    CloseHandle(_doneEvent);
+}
+
+void NetBulkConnect::Start()
+{
+    REFLIB_ASSERT_RETURN_IF_FAILED(_service, "NetBulkConnect: service is null");
+    REFLIB_ASSERT_RETURN_IF_FAILED(_factory, "NetBulkConnect: factory is null");
+
+    _startTick = GetTickCount64();
+
+    uint32 initial = (std::min)(_policy.maxPending, _count);
+    for (uint32 i = 0; i < initial; ++i)
+        LaunchNext();
+}
+
+void NetBulkConnect::Cancel()
+{
+    _cancelRequested = true;
+
+    // claim whatever was not launched yet
+    for (uint32 index = _next.fetch_add(1); index < _count; index = _next.fetch_add(1))
+        Finish(index, NET_CONNECT_CANCELLED, std::shared_ptr<NetObj>());
+}
+
+bool NetBulkConnect::Wait(uint32 timeoutMsec)
+{
+    return WaitForSingleObject(_doneEvent, timeoutMsec) == WAIT_OBJECT_0;
+}
+
+// Moves on past indexes that fail to launch, so one call keeps one connect in flight.
+void NetBulkConnect::LaunchNext()
+{
+    for (;;)
+    {
+        uint32 index = _next.fetch_add(1);
+        if (index >= _count)
+            return;
+
+        if (_cancelRequested)
+        {
+            Finish(index, NET_CONNECT_CANCELLED, std::shared_ptr<NetObj>());
+            continue;
+        }
+
+        if (Launch(index))
+            return;
+    }
+}
+
+bool NetBulkConnect::Launch(uint32 index)
+{
+    auto obj = _factory(index);
+    if (!obj)
+    {
+        Finish(index, NET_CONNECT_FAIL_REGISTER, std::shared_ptr<NetObj>());
+        return false;
+    }
+
+    // the completion may run before ConnectAsync returns
+    _objs[index] = obj;
+    _launchUsec[index] = RttEstimator::GetMicroTick();
+
+    NetConnectResult result = _service->ConnectAsync(_addr, obj, this, index);
+    if (result != NET_CONNECT_OK)
+    {
+        _objs[index].reset();
+        Finish(index, result, std::shared_ptr<NetObj>());
+        return false;
+    }
+
+    return true;
+}
+
+void NetBulkConnect::OnConnectResult(uint32 tag, bool connected)
+{
+    if (tag < 0 || tag >= _count)
+        return;
+
+    if (connected)
+        _latencyUsec[tag] = RttEstimator::GetMicroTick() - _launchUsec[tag];
+
+    std::shared_ptr<NetObj> obj = std::move(_objs[tag]);
+
+    // refill the window before reporting; this index keeps the object alive meanwhile
+    LaunchNext();
+
+    Finish(tag, connected ? NET_CONNECT_OK : NET_CONNECT_FAIL_REMOTE,
+        connected ? obj : std::shared_ptr<NetObj>());
+}
+
+void NetBulkConnect::Finish(uint32 index, NetConnectResult result, std::shared_ptr<NetObj> obj)
+{
+    _results[index] = static_cast<uint16>(result);
+
+    if (result == NET_CONNECT_OK)
+    {
+        ++_connected;
+        if (_callbacks.onConnected)
+            _callbacks.onConnected(index, obj);
+    }
+    else
+    {
+        if (result == NET_CONNECT_CANCELLED)
+            ++_cancelled;
+        else
+            ++_failed;
+
+        if (_callbacks.onFailed)
+            _callbacks.onFailed(index, result);
+    }
+
+    uint32 done = ++_finished;
+    if (done == _count)
+        _endTick = GetTickCount64();
+
+    if (_callbacks.onProgress)
+        _callbacks.onProgress(done, _count);
+
+    HANDLE doneEvent = _doneEvent;
+    if (_outstanding.fetch_sub(1) == 1)
+        SetEvent(doneEvent);
+}
+
+void NetBulkConnect::GetReport(NetBulkConnectReport& report) const
+{
+    report.requested = _count;
+    report.connected = _connected;
+    report.failed = _failed;
+    report.cancelled = _cancelled;
+
+    uint64 end = _endTick;
+    report.elapsedMsec = (end ? end : GetTickCount64()) - _startTick;
+
+    std::vector<uint64> samples;
+    samples.reserve(report.connected);
+    for (uint32 i = 0; i < _count; ++i)
+    {
+        if (_results[i] == NET_CONNECT_OK)
+            samples.push_back(_latencyUsec[i]);
+    }
+
+    if (samples.empty())
+        return;
+
+    std::sort(samples.begin(), samples.end());
+
+    // nearest rank
+    auto percentile = [&samples](uint64 p) {
+        size_t rank = static_cast<size_t>((p * samples.size() + 99) / 100);
+        return samples[(std::max)(rank, static_cast<size_t>(1)) - 1];
+    };
+
+    report.latencyP50Usec = percentile(50);
+    report.latencyP90Usec = percentile(90);
+    report.latencyP99Usec = percentile(99);
+    report.latencyMaxUsec = samples.back();
+}
+
+} // namespace RefLib
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include "reflib_type_def.h"
+#include "reflib_net_def.h"
+#include "reflib_net_connection.h"
+
+namespace RefLib
+{
+
+class NetObj;
+class NetClientService;
+
+struct NetBulkConnectPolicy
+{
+    NetBulkConnectPolicy() : maxPending(256) {}
+
+    uint32 maxPending;      // connects in flight at once
+};
+
+// Callbacks run on the launching thread or on worker threads, concurrently.
+struct NetBulkConnectCallbacks
+{
+    // as the connect completes, before the NetObj's OnConnected
+    std::function<void(uint32 index, std::shared_ptr<NetObj> obj)> onConnected;
+    std::function<void(uint32 index, NetConnectResult reason)> onFailed;
+    std::function<void(uint32 done, uint32 total)> onProgress;
+};
+
+struct NetBulkConnectReport
+{
+    NetBulkConnectReport()
+        : elapsedMsec(0), requested(0), connected(0), failed(0), cancelled(0)
+        , latencyP50Usec(0), latencyP90Usec(0), latencyP99Usec(0), latencyMaxUsec(0)
+    {
+    }
+
+    uint64 elapsedMsec;
+    uint32 requested;
+    uint32 connected;
+    uint32 failed;
+    uint32 cancelled;
+
+    // from launch to connect completion, over the connects that went through
+    uint64 latencyP50Usec;
+    uint64 latencyP90Usec;
+    uint64 latencyP99Usec;
+    uint64 latencyMaxUsec;
+};
+
+typedef std::function<std::shared_ptr<NetObj>(uint32 index)> NetBulkObjFactory;
+
+// Opens count outbound connections with at most policy.maxPending in flight.
+// The first batch is launched by Start; after that every completion launches
+// the next one from the worker thread that reported it.
+// Keep it alive until IsDone; the destructor cancels and waits.
+class NetBulkConnect : public NetConnectObserver
+{
+public:
+    NetBulkConnect(NetClientService* service, const SOCKADDR_IN& addr, uint32 count,
+        NetBulkObjFactory factory, const NetBulkConnectPolicy& policy, const NetBulkConnectCallbacks& callbacks);
+    virtual ~NetBulkConnect();
+
+    void Start();
+
+    // launches nothing more; connects in flight still report
+    void Cancel();
+    bool Wait(uint32 timeoutMsec);
+    bool IsDone() const { return _outstanding == 0; }
+
+    // percentiles are complete once IsDone
+    void GetReport(NetBulkConnectReport& report) const;
+
+    virtual void OnConnectResult(uint32 tag, bool connected) override;
+
+private:
+    void LaunchNext();
+    bool Launch(uint32 index);
+    void Finish(uint32 index, NetConnectResult result, std::shared_ptr<NetObj> obj);
+
+    NetClientService* _service;
+    SOCKADDR_IN _addr;
+    uint32 _count;
+    NetBulkObjFactory _factory;
+    NetBulkConnectPolicy _policy;
+    NetBulkConnectCallbacks _callbacks;
+
+    // per index, each written by the one launch or completion that owns it
+    std::vector<std::shared_ptr<NetObj>> _objs;
+    std::vector<uint64> _launchUsec;
+    std::vector<uint64> _latencyUsec;
+    std::vector<uint16> _results;   // NetConnectResult, NET_CONNECT_RESULT_CNT until finished
+
+    std::atomic<uint32> _next;
+    std::atomic<uint32> _finished;
+    std::atomic<uint32> _outstanding;   // last access to this object is the decrement to 0
+    std::atomic<uint32> _connected;
+    std::atomic<uint32> _failed;
+    std::atomic<uint32> _cancelled;
+    std::atomic<bool> _cancelRequested;
+
+    uint64 _startTick;
+    std::atomic<uint64> _endTick;
+    HANDLE _doneEvent;
+};
+
+} // namespace RefLib
@@ -0,0 +1,331 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include "reflib_net_client_pool.h"
+#include "reflib_net_service.h"
+#include "reflib_net_connection.h"
+
+namespace RefLib
+{
+
+/////////////////////////////////////////////////////////////////////
+// NetPooledObj
+
+NetPooledObj::NetPooledObj(std::weak_ptr<NetService> container)
+    : NetObj(container)
+    , _endpoint(0)
+    , _member(0)
+    , _ready(false)
+    , _inFlight(0)
+    , _connId(NET_OBJ_NO_HANDLE)
+    , _failedId(NET_OBJ_NO_HANDLE)
+{
+}
+
+NetPooledObj::~NetPooledObj()
+{
+}
+
+void NetPooledObj::CompleteRequest()
+{
+    // the count was dropped already if the connection closed meanwhile
+    uint32 cnt = _inFlight.load();
+    while (cnt > 0 && !_inFlight.compare_exchange_weak(cnt, cnt - 1))
+    {
+    }
+}
+
+void NetPooledObj::OnConnected()
+{
+    NetObj::OnConnected();
+
+    _ready = true;
+
+    if (auto pool = _pool.lock())
+        pool->OnConnected(this);
+}
+
+void NetPooledObj::NotifyConnected(const CompositId& id)
+{
+    _connId = id.GetIndex();
+    NetObj::NotifyConnected(id);
+}
+
+// Only the connection the member is on may schedule a reconnect: the
+// connected one once, or the current attempt once if it fails. Reports from
+// a connection the member has left, or repeated ones, are dropped.
+void NetPooledObj::NotifyDisconnected(const CompositId& id)
+{
+    uint64 index = id.GetIndex();
+
+    uint64 expected = index;
+    if (!_connId.compare_exchange_strong(expected, NET_OBJ_NO_HANDLE))
+    {
+        if (expected != NET_OBJ_NO_HANDLE || index != GetCompId().GetIndex()
+            || _failedId.exchange(index) == index)
+            return;
+    }
+
+    NetObj::NotifyDisconnected(id);
+}
+
+// Also called when a connect attempt fails.
+void NetPooledObj::OnDisconnected()
+{
+    NetObj::OnDisconnected();
+
+    bool wasReady = _ready.exchange(false);
+    _inFlight = 0;
+
+    if (auto pool = _pool.lock())
+        pool->OnDisconnected(this, wasReady);
+}
+
+/////////////////////////////////////////////////////////////////////
+// NetClientPool
+
+NetClientPool::NetClientPool(std::weak_ptr<NetClientService> service, const NetClientPoolPolicy& policy)
+    : _service(service)
+    , _policy(policy)
+    , _endpointCnt(0)
+    , _random(static_cast<unsigned int>(GetTickCount64()))
+    , _closed(false)
+{
+    if (_policy.connections == 0)
+        _policy.connections = 1;
+    if (_policy.reconnectBaseMsec == 0)
+        _policy.reconnectBaseMsec = 1;
+    if (_policy.reconnectMaxMsec < _policy.reconnectBaseMsec)
+        _policy.reconnectMaxMsec = _policy.reconnectBaseMsec;
+}
+
+NetClientPool::~NetClientPool()
+{
+    Close();
+}
+
+int NetClientPool::AddEndpoint(const std::string& ipStr, uint32 port, NetPooledObjFactory factory)
+{
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(factory, "AddEndpoint: factory is null", -1);
+
+    // a bad address would only fail every reconnect
+    IN_ADDR addr;
+    if (inet_pton(AF_INET, ipStr.c_str(), &addr) != 1)
+    {
+        DebugPrint("AddEndpoint: invalid ip address(%s)", ipStr.c_str());
+        return -1;
+    }
+
+    SafeLock::Owner lock(_lock);
+
+    uint32 index = _endpointCnt;
+    if (_closed || index >= NET_CLIENT_POOL_MAX_ENDPOINTS)
+        return -1;
+
+    auto endpoint = std::make_unique<Endpoint>();
+    endpoint->ipStr = ipStr;
+    endpoint->port = port;
+
+    std::weak_ptr<NetClientPool> self = shared_from_this();
+
+    for (uint32 i = 0; i < _policy.connections; ++i)
+    {
+        auto obj = factory();
+        REFLIB_ASSERT_RETURN_VAL_IF_FAILED(obj, "AddEndpoint: factory returned null", -1);
+
+        obj->_pool = self;
+        obj->_endpoint = index;
+        obj->_member = i;
+
+        auto member = std::make_unique<Member>();
+        member->pool = this;
+        member->obj = obj;
+        endpoint->members.push_back(std::move(member));
+    }
+
+    // readers index up to _endpointCnt without the lock
+    _endpoints[index] = std::move(endpoint);
+    _endpointCnt = index + 1;
+
+    for (auto& member : _endpoints[index]->members)
+        Connect(*member);
+
+    return static_cast<int>(index);
+}
+
+void NetClientPool::Close()
+{
+    std::vector<HANDLE> timers;
+    {
+        SafeLock::Owner lock(_lock);
+        if (_closed)
+            return;
+
+        _closed = true;
+
+        for (uint32 i = 0; i < _endpointCnt; ++i)
+        {
+            for (auto& member : _endpoints[i]->members)
+            {
+                if (member->timer)
+                    timers.push_back(member->timer);
+                member->timer = nullptr;
+            }
+        }
+    }
+
+    // a callback may be waiting for the lock, so wait for it outside
+    for (HANDLE timer : timers)
+        ::DeleteTimerQueueTimer(nullptr, timer, INVALID_HANDLE_VALUE);
+}
+
+std::shared_ptr<NetPooledObj> NetClientPool::Acquire(uint32 endpoint)
+{
+    if (endpoint >= _endpointCnt)
+        return std::shared_ptr<NetPooledObj>();
+
+    Endpoint& ep = *_endpoints[endpoint];
+    uint32 cnt = static_cast<uint32>(ep.members.size());
+
+    // least loaded wins; the rotating start spreads ties
+    unsigned int start = ep.cursor.fetch_add(1);
+    NetPooledObj* best = nullptr;
+    uint32 bestLoad = 0;
+
+    for (uint32 i = 0; i < cnt; ++i)
+    {
+        NetPooledObj* obj = ep.members[(start + i) % cnt]->obj.get();
+        if (!obj->IsReady())
+            continue;
+
+        uint32 load = obj->GetInFlight();
+        if (!best || load < bestLoad)
+        {
+            best = obj;
+            bestLoad = load;
+            if (load == 0)
+                break;
+        }
+    }
+
+    if (!best)
+        return std::shared_ptr<NetPooledObj>();
+
+    ++best->_inFlight;
+    ++ep.requests;
+
+    return ep.members[best->_member]->obj;
+}
+
+bool NetClientPool::Send(uint32 endpoint, MemoryBlockPtr packet)
+{
+    auto obj = Acquire(endpoint);
+    if (!obj)
+        return false;
+
+    obj->Send(std::move(packet));
+    return true;
+}
+
+uint32 NetClientPool::GetInFlight(uint32 endpoint) const
+{
+    if (endpoint >= _endpointCnt)
+        return 0;
+
+    uint32 sum = 0;
+    for (auto& member : _endpoints[endpoint]->members)
+        sum += member->obj->GetInFlight();
+
+    return sum;
+}
+
+uint32 NetClientPool::GetReadyCount(uint32 endpoint) const
+{
+    if (endpoint >= _endpointCnt)
+        return 0;
+
+    uint32 ready = 0;
+    for (auto& member : _endpoints[endpoint]->members)
+    {
+        if (member->obj->IsReady())
+            ++ready;
+    }
+
+    return ready;
+}
+
+void NetClientPool::Connect(Member& member)
+{
+    auto service = _service.lock();
+    {
+        SafeLock::Owner lock(_lock);
+        if (_closed || !service)
+            return;
+    }
+
+    Endpoint& ep = *_endpoints[member.obj->_endpoint];
+    if (!service->Connect(ep.ipStr, ep.port, member.obj))
+        ScheduleReconnect(member);
+}
+
+// Equal jitter: half the exponential backoff is fixed, the other half random,
+// so members dropped together do not reconnect together.
+void NetClientPool::ScheduleReconnect(Member& member)
+{
+    SafeLock::Owner lock(_lock);
+    if (_closed)
+        return;
+
+    uint32 shift = (std::min)(member.attempts, 20);
+    uint64 backoff = (std::min)(static_cast<uint64>(_policy.reconnectBaseMsec) << shift,
+        static_cast<uint64>(_policy.reconnectMaxMsec));
+    uint64 delay = backoff / 2 + _random() % (backoff / 2 + 1);
+
+    ++member.attempts;
+
+    // the previous timer has fired; this may be its own callback, so no waiting
+    if (member.timer)
+        ::DeleteTimerQueueTimer(nullptr, member.timer, nullptr);
+
+    if (!::CreateTimerQueueTimer(&member.timer, nullptr, &NetClientPool::OnReconnectTimer,
+        &member, static_cast<DWORD>((std::max)(delay, 1ULL)), 0, WT_EXECUTEONLYONCE))
+    {
+        DebugPrint("ScheduleReconnect: CreateTimerQueueTimer failed: %d", GetLastError());
+        member.timer = nullptr;
+    }
+}
+
+void CALLBACK NetClientPool::OnReconnectTimer(PVOID param, BOOLEAN timedOut)
+{
+    Member* member = static_cast<Member*>(param);
+    if (member)
+        member->pool->Connect(*member);
+}
+
+void NetClientPool::OnConnected(NetPooledObj* obj)
+{
+    GetMember(obj).attempts = 0;
+    ++_endpoints[obj->_endpoint]->connects;
+}
+
+void NetClientPool::OnDisconnected(NetPooledObj* obj, bool wasReady)
+{
+    if (wasReady)
+        ++_endpoints[obj->_endpoint]->disconnects;
+
+    ScheduleReconnect(GetMember(obj));
+}
+
+void NetClientPool::PrintStatistics()
+{
+    for (uint32 i = 0; i < _endpointCnt; ++i)
+    {
+        Endpoint& ep = *_endpoints[i];
+
+        DebugPrint("ClientPool] %s:%u ready(%u/%u) inFlight(%u) requests(%llu) connects(%llu) disconnects(%llu)",
+            ep.ipStr.c_str(), ep.port, GetReadyCount(i), static_cast<uint32>(ep.members.size()),
+            GetInFlight(i), ep.requests.load(), ep.connects.load(), ep.disconnects.load());
+    }
+}
+
+} // namespace RefLib
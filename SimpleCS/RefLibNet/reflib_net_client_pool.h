@@ -0,0 +1,141 @@
+#pragma once
+
+#include <memory>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <random>
+#include <functional>
+#include "reflib_net_obj.h"
+#include "reflib_net_def.h"
+#include "reflib_safelock.h"
+
+namespace RefLib
+{
+
+class NetService;
+class NetClientService;
+class NetClientPool;
+
+struct NetClientPoolPolicy
+{
+    NetClientPoolPolicy()
+        : connections(4)
+        , reconnectBaseMsec(100)
+        , reconnectMaxMsec(30 * 1000)
+    {
+    }
+
+    uint32 connections;         // per endpoint
+    uint32 reconnectBaseMsec;   // backoff of the first retry, doubled per failed attempt
+    uint32 reconnectMaxMsec;    // backoff cap
+};
+
+// Connection kept by a NetClientPool. Derive backend NetObjs from this and
+// call CompleteRequest when the reply to a request sent through the pool arrives.
+class NetPooledObj : public NetObj
+{
+public:
+    NetPooledObj(std::weak_ptr<NetService> container);
+    virtual ~NetPooledObj();
+
+    bool IsReady() const { return _ready; }
+    uint32 GetInFlight() const { return _inFlight; }
+    void CompleteRequest();
+
+    virtual void OnConnected() override;
+    virtual void OnDisconnected() override;
+
+    virtual void NotifyConnected(const CompositId& id) override;
+    virtual void NotifyDisconnected(const CompositId& id) override;
+
+private:
+    friend class NetClientPool;
+
+    std::weak_ptr<NetClientPool> _pool;
+    uint32 _endpoint;
+    uint32 _member;
+    std::atomic<bool> _ready;
+    std::atomic<uint32> _inFlight;  // requests sent and not completed; dropped on disconnect
+
+    // CompositId index of the connection the member is connected on, and of
+    // the last failed attempt; NET_OBJ_NO_HANDLE if none
+    std::atomic<uint64> _connId;
+    std::atomic<uint64> _failedId;
+};
+
+typedef std::function<std::shared_ptr<NetPooledObj>()> NetPooledObjFactory;
+
+// Keeps policy.connections connections open per backend endpoint and
+// reconnects them with jittered exponential backoff. A request goes to the
+// ready connection with the fewest in flight.
+// Create with make_shared, and Close before the service shuts down.
+class NetClientPool : public std::enable_shared_from_this<NetClientPool>
+{
+public:
+    NetClientPool(std::weak_ptr<NetClientService> service, const NetClientPoolPolicy& policy);
+    ~NetClientPool();
+
+    // Starts connecting; returns the endpoint index or -1.
+    int AddEndpoint(const std::string& ipStr, uint32 port, NetPooledObjFactory factory);
+
+    // stop reconnecting; connections stay open until the service shuts down
+    void Close();
+
+    // null if no connection to the endpoint is ready
+    std::shared_ptr<NetPooledObj> Acquire(uint32 endpoint);
+    bool Send(uint32 endpoint, MemoryBlockPtr packet);
+
+    uint32 GetInFlight(uint32 endpoint) const;
+    uint32 GetReadyCount(uint32 endpoint) const;
+
+    void PrintStatistics();
+
+private:
+    friend class NetPooledObj;
+
+    struct Member
+    {
+        Member() : pool(nullptr), attempts(0), timer(nullptr) {}
+
+        NetClientPool* pool;
+        std::shared_ptr<NetPooledObj> obj;
+        uint32 attempts;        // failed connects since the last success
+        HANDLE timer;
+    };
+
+    struct Endpoint
+    {
+        Endpoint() : port(0), cursor(0), requests(0), connects(0), disconnects(0) {}
+
+        std::string ipStr;
+        uint32 port;
+        std::vector<std::unique_ptr<Member>> members;  // fixed once published
+
+        std::atomic<unsigned int> cursor;     // unsigned: stays a valid modulo base after it wraps
+        std::atomic<uint64> requests;
+        std::atomic<uint64> connects;
+        std::atomic<uint64> disconnects;
+    };
+
+    Member& GetMember(NetPooledObj* obj) { return *_endpoints[obj->_endpoint]->members[obj->_member]; }
+
+    void Connect(Member& member);
+    void ScheduleReconnect(Member& member);
+    static void CALLBACK OnReconnectTimer(PVOID param, BOOLEAN timedOut);
+
+    void OnConnected(NetPooledObj* obj);
+    void OnDisconnected(NetPooledObj* obj, bool wasReady);
+
+    std::weak_ptr<NetClientService> _service;
+    NetClientPoolPolicy _policy;
+
+    std::unique_ptr<Endpoint> _endpoints[NET_CLIENT_POOL_MAX_ENDPOINTS];
+    std::atomic<uint32> _endpointCnt;
+
+    SafeLock _lock;             // endpoints being added, reconnect timers and the jitter source
+    std::minstd_rand _random;
+    bool _closed;
+};
+
+} // namespace RefLib
@@ -15,6 +15,8 @@ public:
 		OP_READ,
 		OP_WRITE,
 		OP_DISCONNECT,
+		OP_RESUME,      // posted, not socket I/O: resume reads on an I/O thread
+		OP_TYPE_CNT,
 	};
 
 	NetCompletionOP(NetOPType op_)
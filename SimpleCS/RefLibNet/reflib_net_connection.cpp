@@ -3,13 +3,21 @@
 #include "reflib_net_connection.h"
 #include "reflib_net_connection_proxy.h"
 #include "reflib_net_obj.h"
+#include "reflib_net_affinity.h"
 
 namespace RefLib
 {
 
-void NetConnection::RegisterParent(std::weak_ptr<NetObj> parent)
+void NetConnection::RegisterParent(std::weak_ptr<NetObj> parent, bool pinned)
 {
     _parent = parent;
+    _pinned = pinned;
+}
+
+void NetConnection::ReleaseParent()
+{
+    _parent.reset();
+    _pinned = false;
 }
 
 bool NetConnection::Initialize(SOCKET sock, NetConnectionProxy* container)
@@ -17,9 +25,33 @@ bool NetConnection::Initialize(SOCKET sock, NetConnectionProxy* container)
     REFLIB_ASSERT_RETURN_VAL_IF_FAILED(container, "NetConnection::Initialize: NetConnectionProxy is null", false);
     _container = container;
 
+    NetSocket::SetRecvMode(container->GetRecvMode());
+    NetSocket::SetProfiler(container);
+    NetSocket::SetFloodPolicy(container->GetFloodPolicy());
+    NetSocket::SetRecvBudget(container->GetRecvMemoryBudget());
+    NetSocket::SetTimeoutPolicy(container->GetTimeoutPolicy());
+    NetSocket::SetTimerWheel(&container->GetTimerWheel());
+
     return NetSocket::Initialize(sock);
 }
 
+void NetConnection::SetShard(NetShard* shard)
+{
+    ReleaseShard();
+    _shard = shard;
+
+    NetSocket::SetTimerWheel(&shard->GetTimerWheel());
+
+    if (auto p = _parent.lock())
+        p->SetCompletionPort(shard->GetLogicPort());
+}
+
+void NetConnection::ReleaseShard()
+{
+    if (NetShard* shard = _shard.exchange(nullptr))
+        shard->Release();
+}
+
 // called by NetSocket::OnRecvData()
 bool NetConnection::RecvPacket(MemoryBlock* packet) 
 {
@@ -30,26 +62,75 @@ bool NetConnection::RecvPacket(MemoryBlock* packet)
     return p->RecvPacket(packet);
 }
 
+uint64 NetConnection::GetQueuedRecvBytes() const
+{
+    auto p = _parent.lock();
+    return p ? p->GetQueuedRecvBytes() : 0;
+}
+
+bool NetConnection::IsDispatchIdle() const
+{
+    auto p = _parent.lock();
+    return !p || p->IsDispatchIdle();
+}
+
+void NetConnection::OnDrain(uint64 deadline)
+{
+    if (auto p = _parent.lock())
+        p->OnDrain(deadline);
+}
+
 void NetConnection::OnConnected()
 {
     NetSocket::OnConnected();
 
+    // reported as the connect completes, ahead of the NetObj's own handling
+    if (NetConnectObserver* observer = _connectObserver)
+    {
+        _connectObserver = nullptr;
+        observer->OnConnectResult(_connectTag, true);
+    }
+
     auto p = _parent.lock();
     REFLIB_ASSERT_RETURN_IF_FAILED(p, "OnConnected: parent is nullptr");
-    if (p) p->OnConnected();
+    if (p) p->NotifyConnected(GetCompId());
 }
 
 void NetConnection::OnDisconnected()
 {
+    // still set if the connect itself failed; the slot may be reused once freed
+    NetConnectObserver* observer = _connectObserver;
+    uint32 tag = _connectTag;
+    _connectObserver = nullptr;
+
     NetSocket::OnDisconnected();
 
     auto p = _parent.lock();
     REFLIB_ASSERT(p, "OnDisconnected: parent is nullptr");
-    if (p) p->OnDisconnected();
+    if (p) p->NotifyDisconnected(GetCompId());
 
     REFLIB_ASSERT_RETURN_IF_FAILED(_container, "OnDisconnected: container is nullptr");
 
+    if (_admittedAddr != 0)
+    {
+        _container->ReleaseAdmission(_admittedAddr);
+        _admittedAddr = 0;
+    }
+
+    ReleaseShard();
+
     _container->FreeNetCon(GetCompId());
+
+    if (observer)
+        observer->OnConnectResult(tag, false);
+}
+
+// The connection was freed while I/O was in flight; its last completion is in.
+// A stale call after the slot moved on loses in the manager.
+void NetConnection::OnIoReleased()
+{
+    if (_container)
+        _container->RecycleNetCon(GetCompId());
 }
 
 } // namespace RefLib
\ No newline at end of file
@@ -8,6 +8,15 @@ namespace RefLib
 
 class GameObj;
 class NetConnectionProxy;
+class NetShard;
+
+// Told once whether an outbound connect went through; tag is the caller's.
+class NetConnectObserver
+{
+public:
+    virtual ~NetConnectObserver() {}
+    virtual void OnConnectResult(uint32 tag, bool connected) = 0;
+};
 
 class NetConnection : public NetSocket
 {
@@ -15,6 +24,11 @@ public:
     NetConnection(uint32 id, uint32 salt)
         : _id(id, salt)
         , _container(nullptr)
+        , _pinned(false)
+        , _admittedAddr(0)
+        , _connectObserver(nullptr)
+        , _connectTag(0)
+        , _shard(nullptr)
     {}
 
     CompositId GetCompId() const { return _id; }
@@ -25,18 +39,50 @@ public:
         _id.IncSalt();
     }
 
-    void RegisterParent(std::weak_ptr<NetObj> parent);
+    // A pinned parent stays with the connection across reconnects.
+    void RegisterParent(std::weak_ptr<NetObj> parent, bool pinned = false);
+    void ReleaseParent();
+    bool HasParent() const { return !_parent.expired(); }
+    bool IsPinned() const { return _pinned; }
 
     bool Initialize(SOCKET sock, NetConnectionProxy* container);
 
+    // source address charged to the listener's admission table, 0 if none
+    void SetAdmittedAddr(uint32 addr) { _admittedAddr = addr; }
+
+    // set before the connect is posted; cleared when its result is reported
+    void SetConnectObserver(NetConnectObserver* observer, uint32 tag)
+    {
+        _connectObserver = observer;
+        _connectTag = tag;
+    }
+
+    // Set before the socket is associated. The NetObj's packets go to the shard's
+    // logic port and the deadlines to the wheel of the shard's I/O threads.
+    void SetShard(NetShard* shard);
+    NetShard* GetShard() const { return _shard; }
+    // safe to race: only one caller releases the shard
+    void ReleaseShard();
+
     virtual bool RecvPacket(MemoryBlock* packet) override;
+    virtual uint64 GetQueuedRecvBytes() const override;
+    virtual bool IsDispatchIdle() const override;
+    // the service is draining; the NetObj should move its player by deadline
+    void OnDrain(uint64 deadline);
+
     virtual void OnConnected() override;
     virtual void OnDisconnected() override;
+    virtual void OnIoReleased() override;
 
 private:
     CompositId _id;
     std::weak_ptr<NetObj> _parent;
     NetConnectionProxy* _container;
+    bool _pinned;
+    uint32 _admittedAddr;
+    NetConnectObserver* _connectObserver;
+    uint32 _connectTag;
+    std::atomic<NetShard*> _shard;
 };
 
 } // namespace RefLib
@@ -7,7 +7,10 @@ namespace RefLib
 {
 
 NetConnectionMgr::NetConnectionMgr()
-	: _capacity(NETWORK_MAX_CONN)
+	: _cachedCnt(0)
+	, _busyCnt(0)
+	, _capacity(0)
+	, _freeCacheSize(NETWORK_CONN_FREE_CACHE)
 	, _isActive(false)
 {
 }
@@ -18,11 +21,20 @@ NetConnectionMgr::~NetConnectionMgr()
 
 bool NetConnectionMgr::Initialize(uint32 capacity)
 {
-	SafeLock::Owner owner(_conLock);
+	REFLIB_ASSERT_RETURN_VAL_IF_FAILED(!_slots, "NetConnectionMgr is already initialized", false);
+	REFLIB_ASSERT_RETURN_VAL_IF_FAILED(capacity > 0, "NetConnectionMgr: invalid capacity", false);
 
-	for (uint32 i = 0; i < capacity; ++i)
+	_slots.reset(new ConSlot[capacity]);
+	_links.reset(new std::atomic<uint32>[capacity]);
+
+	_emptySlots.Initialize(_links.get());
+	_cachedSlots.Initialize(_links.get());
+	_pendingSlots.Initialize(_links.get());
+
+	// lowest slot is handed out first
+	for (uint32 i = capacity; i > 0; --i)
 	{
-		_freeCons.emplace(i, std::make_shared<NetConnection>(i, 0));
+		_emptySlots.Push(i - 1);
 	}
 
 	_capacity = capacity;
@@ -35,100 +47,290 @@ void NetConnectionMgr::Shutdown()
 {
 	_isActive = false;
 
-    SafeLock::Owner owner(_conLock);
+	std::vector<std::shared_ptr<NetConnection>> busy;
+	{
+		SafeLock::Owner lock(_conLock);
+		for (uint32 i = 0; i < _capacity; ++i)
+		{
+			if (GetTagState(_slots[i].tag.load()) == CON_SLOT_BUSY && _slots[i].con)
+				busy.push_back(_slots[i].con);
+		}
+	}
 
-	for (auto& elem : _busyCons)
+	// a disconnect may free its slot and evict the connection
+	for (auto& con : busy)
 	{
-		auto con = elem.second;
-        if (con.get())
-            con->Disconnect(NET_CTYPE_SHUTDOWN);
-    }
+		con->Disconnect(NET_CTYPE_SHUTDOWN);
+	}
 }
 
 bool NetConnectionMgr::IsEmpty()
 {
-    SafeLock::Owner owner(_conLock);
-    
-	return (_freeCons.size() + _pendingCons.size() == _capacity);
+	return _busyCnt == 0;
 }
 
-std::weak_ptr<NetConnection> NetConnectionMgr::RegisterCon()
+void NetConnectionMgr::GetConnections(std::vector<std::shared_ptr<NetConnection>>& cons)
 {
-	SafeLock::Owner owner(_conLock);
+	SafeLock::Owner lock(_conLock);
 
-	if (!_isActive || _freeCons.empty())
+	for (uint32 i = 0; i < _capacity; ++i)
 	{
-		return std::weak_ptr<NetConnection>();
+		if (_slots[i].con)
+			cons.push_back(_slots[i].con);
+	}
+}
+
+void NetConnectionMgr::SetSlotCon(uint32 slot, std::shared_ptr<NetConnection> con)
+{
+	{
+		SafeLock::Owner lock(_conLock);
+		_slots[slot].con.swap(con);
+	}
+
+	// an evicted connection is destroyed here, outside the lock; its
+	// destructor may wait for its timer callback
+	con.reset();
+}
+
+// A cached connection, or a slot with a freshly built one.
+uint32 NetConnectionMgr::TakeFreeSlot()
+{
+	uint32 slot = _cachedSlots.Pop();
+	if (slot != SLOT_LIST_END)
+	{
+		--_cachedCnt;
+		return slot;
 	}
 
-	auto it = _freeCons.begin();
-	auto con = it->second;
-	_freeCons.erase(it);
-	_pendingCons.emplace(con->GetCompId().GetSlotId(), con);
+	slot = _emptySlots.Pop();
+	if (slot == SLOT_LIST_END)
+		return SLOT_LIST_END;
+
+	uint32 salt = GetTagSalt(_slots[slot].tag.load());
+	SetSlotCon(slot, std::make_shared<NetConnection>(slot, salt));
+
+	return slot;
+}
+
+uint32 NetConnectionMgr::Materialize(uint32 count)
+{
+	uint32 built = 0;
+	while (_cachedCnt < count)
+	{
+		uint32 slot = _emptySlots.Pop();
+		if (slot == SLOT_LIST_END)
+			break;
+
+		uint32 salt = GetTagSalt(_slots[slot].tag.load());
+		SetSlotCon(slot, std::make_shared<NetConnection>(slot, salt));
+
+		++_cachedCnt;
+		_cachedSlots.Push(slot);
+		++built;
+	}
+
+	return built;
+}
+
+// The caller owns the slot; the new salt retires every id of the previous use.
+std::shared_ptr<NetConnection> NetConnectionMgr::MarkBusy(uint32 slot)
+{
+	auto con = _slots[slot].con;
+
+	con->IncSalt();
+	con->AddIoRef();
+	_slots[slot].tag.store(MakeTag(con->GetCompId().GetSalt(), CON_SLOT_BUSY));
+	++_busyCnt;
 
 	return con;
 }
 
-std::weak_ptr<NetConnection> NetConnectionMgr::AllocNetCon()
+std::weak_ptr<NetConnection> NetConnectionMgr::RegisterCon(bool pinned)
 {
-    std::shared_ptr<NetConnection> con;
+	if (!_isActive)
+	{
+		return std::weak_ptr<NetConnection>();
+	}
 
-	if (!_isActive) 
+	uint32 slot = TakeFreeSlot();
+	if (slot == SLOT_LIST_END)
 	{
-		return con;
+		return std::weak_ptr<NetConnection>();
 	}
 
-    SafeLock::Owner owner(_conLock);
+	auto con = _slots[slot].con;
+	uint32 salt = con->GetCompId().GetSalt();
+
+	_slots[slot].tag.store(MakeTag(salt, pinned ? CON_SLOT_PINNED : CON_SLOT_PENDING));
+	if (pinned)
+		_pendingSlots.Push(slot);
+
+	return con;
+}
+
+void NetConnectionMgr::UnregisterCon(CompositId compId)
+{
+	uint32 slot = compId.GetSlotId();
+	if (slot < 0 || slot >= _capacity)
+		return;
+
+	uint64 expected = MakeTag(compId.GetSalt(), CON_SLOT_PENDING);
+	if (!_slots[slot].tag.compare_exchange_strong(expected, MakeTag(compId.GetSalt(), CON_SLOT_FREE)))
+		return;
+
+	auto con = _slots[slot].con;
+	ReleaseSlot(slot, con);
+}
 
-    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(!_pendingCons.empty(), "Out of network connection.", con);
+std::weak_ptr<NetConnection> NetConnectionMgr::AllocNetCon()
+{
+	if (!_isActive) 
+	{
+		return std::weak_ptr<NetConnection>();
+	}
 
-	auto it = _pendingCons.begin();
-	con = it->second;
-	_pendingCons.erase(it);
+	// registered connections first, then a cached or newly built one
+	uint32 slot = _pendingSlots.Pop();
+	if (slot == SLOT_LIST_END)
+		slot = TakeFreeSlot();
 
-    con->IncSalt();
-	_busyCons.emplace(con->GetCompId().GetIndex(), con);
+	REFLIB_ASSERT_RETURN_VAL_IF_FAILED(slot != SLOT_LIST_END, "Out of network connection.", std::weak_ptr<NetConnection>());
 
-    return con;
+	return MarkBusy(slot);
 }
 
 std::weak_ptr<NetConnection> NetConnectionMgr::AllocNetCon(CompositId compId)
 {
-	std::shared_ptr<NetConnection> con;
+	uint32 slot = compId.GetSlotId();
 
-	SafeLock::Owner owner(_conLock);
+	if (!_isActive || slot < 0 || slot >= _capacity)
+	{
+		return std::weak_ptr<NetConnection>();
+	}
 
-	if (!_isActive)
+	uint64 expected = MakeTag(compId.GetSalt(), CON_SLOT_PENDING);
+	if (!_slots[slot].tag.compare_exchange_strong(expected, MakeTag(compId.GetSalt(), CON_SLOT_CLAIMED)))
 	{
-		return con;
+		return std::weak_ptr<NetConnection>();
 	}
 
-	auto it = _pendingCons.find(compId.GetSlotId());
-	if (it == _pendingCons.end())
+	return MarkBusy(slot);
+}
+
+void NetConnectionMgr::Adopt(const std::vector<CompositId>& ids, std::vector<std::shared_ptr<NetConnection>>& cons)
+{
+	cons.assign(ids.size(), std::shared_ptr<NetConnection>());
+	if (!_isActive)
+		return;
+
+	// Empty both free lists to pick slots out of them, then put the rest back.
+	// A cached connection carries its own salt, so it is rebuilt like an empty slot.
+	enum { SLOT_TAKEN, SLOT_EMPTY, SLOT_CACHED };
+
+	std::vector<uint32> empty;
+	std::vector<uint32> cached;
+	std::vector<char> origin(_capacity, SLOT_TAKEN);
+	for (uint32 slot = _emptySlots.Pop(); slot != SLOT_LIST_END; slot = _emptySlots.Pop())
 	{
-		return con;
+		empty.push_back(slot);
+		origin[slot] = SLOT_EMPTY;
 	}
+	for (uint32 slot = _cachedSlots.Pop(); slot != SLOT_LIST_END; slot = _cachedSlots.Pop())
+	{
+		cached.push_back(slot);
+		origin[slot] = SLOT_CACHED;
+	}
+
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		uint32 slot = ids[i].GetSlotId();
+		if (slot < 0 || slot >= _capacity || origin[slot] == SLOT_TAKEN)
+			continue;
 
-	con = it->second;
-	_pendingCons.erase(it);
+		if (origin[slot] == SLOT_CACHED)
+			--_cachedCnt;
+		origin[slot] = SLOT_TAKEN;
 
-	con->IncSalt();
-	_busyCons.emplace(con->GetCompId().GetIndex(), con);
+		auto con = std::make_shared<NetConnection>(slot, ids[i].GetSalt());
+		con->AddIoRef();
+		SetSlotCon(slot, con);
+		_slots[slot].tag.store(MakeTag(ids[i].GetSalt(), CON_SLOT_BUSY));
+		++_busyCnt;
 
-	return con;
+		cons[i] = con;
+	}
+
+	// popped lowest first; push back in reverse so the lowest is on top again
+	for (auto it = empty.rbegin(); it != empty.rend(); ++it)
+	{
+		if (origin[*it] == SLOT_EMPTY)
+			_emptySlots.Push(*it);
+	}
+	for (auto it = cached.rbegin(); it != cached.rend(); ++it)
+	{
+		if (origin[*it] == SLOT_CACHED)
+			_cachedSlots.Push(*it);
+	}
 }
 
 void NetConnectionMgr::FreeNetCon(CompositId compId)
 {
-	SafeLock::Owner owner(_conLock);
+	uint32 slot = compId.GetSlotId();
+	if (slot < 0 || slot >= _capacity)
+		return;
+
+	// a stale id carries an old salt and loses here
+	uint64 expected = MakeTag(compId.GetSalt(), CON_SLOT_BUSY);
+	if (!_slots[slot].tag.compare_exchange_strong(expected, MakeTag(compId.GetSalt(), CON_SLOT_CLOSING)))
+		return;
+
+	auto con = _slots[slot].con;
+
+	// an op still in flight holds the connection until its completion recycles it
+	if (con->ReleaseIoRef())
+		RecycleNetCon(compId);
+}
+
+void NetConnectionMgr::RecycleNetCon(CompositId compId)
+{
+	uint32 slot = compId.GetSlotId();
+	if (slot < 0 || slot >= _capacity)
+		return;
 
-	auto it = _busyCons.find(compId.GetIndex());
-	if (it != _busyCons.end())
+	uint64 expected = MakeTag(compId.GetSalt(), CON_SLOT_CLOSING);
+	if (!_slots[slot].tag.compare_exchange_strong(expected, MakeTag(compId.GetSalt(), CON_SLOT_FREE)))
+		return;
+
+	--_busyCnt;
+
+	auto con = _slots[slot].con;
+
+	// a pinned NetObj waits for the next accept on the same connection
+	if (con->IsPinned())
 	{
-		auto con = it->second;
-		_busyCons.erase(it);
-		_freeCons.emplace(compId.GetSlotId(), con);
+		_slots[slot].tag.store(MakeTag(compId.GetSalt(), CON_SLOT_PINNED));
+		_pendingSlots.Push(slot);
+		return;
 	}
+
+	ReleaseSlot(slot, con);
+}
+
+// The caller has moved the slot to FREE and owns it.
+void NetConnectionMgr::ReleaseSlot(uint32 slot, const std::shared_ptr<NetConnection>& con)
+{
+	con->ReleaseParent();
+
+	if (_cachedCnt.fetch_add(1) < _freeCacheSize)
+	{
+		_cachedSlots.Push(slot);
+		return;
+	}
+
+	// the slot keeps its salt for the next connection built on it
+	--_cachedCnt;
+	SetSlotCon(slot, std::shared_ptr<NetConnection>());
+	_emptySlots.Push(slot);
 }
 
 } // namespace RefLib
@@ -2,11 +2,10 @@
 
 #include <atomic>
 #include <vector>
-#include <map>
 #include <memory>
-#include <concurrent_queue.h>
-#include "reflib_safelock.h"
+#include "reflib_slot_list.h"
 #include "reflib_composit_id.h"
+#include "reflib_safelock.h"
 
 namespace RefLib
 {
@@ -19,28 +18,84 @@ public:
     NetConnectionMgr();
     ~NetConnectionMgr();
 
+    // Reserves capacity slots; connections are built on first use.
     bool Initialize(uint32 capacity);
-    std::weak_ptr<NetConnection> RegisterCon();
+    std::weak_ptr<NetConnection> RegisterCon(bool pinned);
+    // Gives back a slot registered for a connect that never started.
+    // Loses to anything that already claimed the slot.
+    void UnregisterCon(CompositId compId);
     void Shutdown();
 
     std::weak_ptr<NetConnection> AllocNetCon();
     std::weak_ptr<NetConnection> AllocNetCon(CompositId compId);
+    // The slot is recycled once the connection's in-flight I/O completes,
+    // which may be right here or in RecycleNetCon.
     void FreeNetCon(CompositId compId);
+    void RecycleNetCon(CompositId compId);
+
+    // Hot restart, before anything else allocates: builds busy connections on
+    // the exact slots and salts named by ids. cons[i] is null if the slot is taken.
+    void Adopt(const std::vector<CompositId>& ids, std::vector<std::shared_ptr<NetConnection>>& cons);
 
     bool IsEmpty();
 
+    // Free connections kept built for reuse; the rest release their slot.
+    void SetFreeCacheSize(uint32 size) { _freeCacheSize = size; }
+    uint32 Materialize(uint32 count);
+
+    void GetConnections(std::vector<std::shared_ptr<NetConnection>>& cons);
+
 private:
-	typedef std::map<uint32, std::shared_ptr<NetConnection>> FREE_CONNS;
-	typedef std::map<uint32, std::shared_ptr<NetConnection>> PENDING_CONNS;
-	typedef std::map<uint64, std::shared_ptr<NetConnection>> BUSY_CONNS;
+    enum SlotState
+    {
+        CON_SLOT_FREE,
+        CON_SLOT_PENDING,   // registered for a connect
+        CON_SLOT_PINNED,    // registered for accepts, on _pendingSlots
+        CON_SLOT_CLAIMED,   // between pending and busy
+        CON_SLOT_BUSY,
+        CON_SLOT_CLOSING,   // freed, waiting for its I/O to complete
+    };
+
+    // salt of the slot's connection and its state, updated together
+    struct ConSlot
+    {
+        ConSlot() : tag(0) {}
+
+        // Written only by the slot's owner, under _conLock. The owner is the thread
+        // that popped the slot or moved its tag, and reads it without the lock;
+        // everyone else reads it under _conLock.
+        std::shared_ptr<NetConnection> con;
+        std::atomic<uint64> tag;
+    };
+
+    static uint64 MakeTag(uint32 salt, SlotState state)
+    {
+        return (static_cast<uint64>(static_cast<unsigned int>(salt)) << 32) | state;
+    }
+    static uint32 GetTagSalt(uint64 tag) { return static_cast<uint32>(tag >> 32); }
+    static SlotState GetTagState(uint64 tag) { return static_cast<SlotState>(tag & 0xFFFFFFFF); }
+
+    uint32 TakeFreeSlot();
+    std::shared_ptr<NetConnection> MarkBusy(uint32 slot);
+    void ReleaseSlot(uint32 slot, const std::shared_ptr<NetConnection>& con);
+    void SetSlotCon(uint32 slot, std::shared_ptr<NetConnection> con);
+
+    std::unique_ptr<ConSlot[]> _slots;
+    std::unique_ptr<std::atomic<uint32>[]> _links;
+
+    SlotList _emptySlots;       // no connection built
+    SlotList _cachedSlots;      // idle connection kept built
+    SlotList _pendingSlots;     // pinned NetObj waiting for an accept
+
+    // only connections being built or evicted, and readers of slots they do not own
+    SafeLock _conLock;
 
-    FREE_CONNS		_freeCons;
-	PENDING_CONNS	_pendingCons;
-	BUSY_CONNS		_busyCons;
-    SafeLock		_conLock;
+    std::atomic<uint32> _cachedCnt;
+    std::atomic<uint32> _busyCnt;
 
 	std::atomic<uint32> _capacity;
+	std::atomic<uint32> _freeCacheSize;
 	std::atomic<bool>	_isActive;
 };
 
-} // namespace RefLib
\ No newline at end of file
+} // namespace RefLib
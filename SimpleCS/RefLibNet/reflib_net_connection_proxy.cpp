@@ -4,6 +4,7 @@
 #include "reflib_net_connection.h"
 #include "reflib_net_connection_manager.h"
 #include "reflib_net_service.h"
+#include "reflib_net_api.h"
 #include "reflib_util.h"
 
 namespace RefLib
@@ -24,6 +25,8 @@ NetConnectionProxy::~NetConnectionProxy()
 bool NetConnectionProxy::Initialize(unsigned maxCnt, uint32 concurrency)
 {
     _isClosed = false;
+	if (_container)
+		_conMgr->SetFreeCacheSize(_container->GetConnectionCacheSize());
 	if (!_conMgr->Initialize(maxCnt))
 	{
 		return false;
@@ -31,32 +34,80 @@ bool NetConnectionProxy::Initialize(unsigned maxCnt, uint32 concurrency)
 	return NetWorker::Initialize(concurrency);
 }
 
-std::weak_ptr<NetConnection> NetConnectionProxy::RegisterCon()
+std::weak_ptr<NetConnection> NetConnectionProxy::RegisterCon(bool pinned)
 {
-    return _conMgr->RegisterCon();
+    return _conMgr->RegisterCon(pinned);
+}
+
+void NetConnectionProxy::UnregisterCon(const CompositId& id)
+{
+    _conMgr->UnregisterCon(id);
 }
 
 std::weak_ptr<NetConnection> NetConnectionProxy::AllocNetCon(SOCKET sock)
 {
     auto con = _conMgr->AllocNetCon().lock();
-    if (con && con->Initialize(sock, this))
+    if (!con)
+        return con;
+
+    if (AttachNetCon(con, sock))
         return con;
 
     return std::shared_ptr<NetConnection>();
 }
 
+bool NetConnectionProxy::AttachNetCon(std::shared_ptr<NetConnection> con, SOCKET sock)
+{
+    // connections built on demand get their NetObj from the service
+    if (!con->HasParent() && !(_container && _container->AttachNetObj(con)))
+    {
+        DebugPrint("AllocNetCon: no NetObj for connection(%d)", con->GetCompId().GetSlotId());
+        _conMgr->FreeNetCon(con->GetCompId());
+        return false;
+    }
+
+    return con->Initialize(sock, this);
+}
+
 bool NetConnectionProxy::AllocNetCon(const CompositId& id, SOCKET sock)
 {
     auto con = _conMgr->AllocNetCon(id).lock();
 	if (!con) return false;
 	if (!con->Initialize(sock, this))
 	{
-		_conMgr->FreeNetCon(id);
+		// claiming bumped the salt
+		_conMgr->FreeNetCon(con->GetCompId());
 		return false;
 	}
 	return true;
 }
 
+HANDLE NetConnectionProxy::AssignShard(NetConnection& con)
+{
+    NetShard* shard = _container ? _container->GetAffinity().Assign(con.GetCompId().GetSlotId()) : nullptr;
+    if (shard)
+        con.SetShard(shard);
+
+    HANDLE comPort = shard ? shard->GetIOPort() : g_network.GetCompletionPort();
+    con.SetCompletionPort(comPort);
+    return comPort;
+}
+
+void NetConnectionProxy::GetConnections(std::vector<std::shared_ptr<NetConnection>>& cons)
+{
+    _conMgr->GetConnections(cons);
+}
+
+uint32 NetConnectionProxy::Materialize(uint32 count)
+{
+    return _conMgr->Materialize(count);
+}
+
+void NetConnectionProxy::AdoptNetCons(const std::vector<CompositId>& ids, std::vector<std::shared_ptr<NetConnection>>& cons)
+{
+    _conMgr->Adopt(ids, cons);
+}
+
 void NetConnectionProxy::FreeNetCon(const CompositId& id)
 {
     _conMgr->FreeNetCon(id);
@@ -65,6 +116,45 @@ void NetConnectionProxy::FreeNetCon(const CompositId& id)
         OnTerminated();
 }
 
+void NetConnectionProxy::RecycleNetCon(const CompositId& id)
+{
+    _conMgr->RecycleNetCon(id);
+
+    if (_isClosed && _conMgr->IsEmpty())
+        OnTerminated();
+}
+
+void NetConnectionProxy::PrintStatistics()
+{
+    NetProfiler::PrintStatistics();
+    GetTimerWheel().PrintStatistics();
+}
+
+NetRecvMode NetConnectionProxy::GetRecvMode() const
+{
+    return _container ? _container->GetRecvMode() : NET_RECV_MODE_OVERLAPPED;
+}
+
+NetFloodPolicy NetConnectionProxy::GetFloodPolicy() const
+{
+    return _container ? _container->GetFloodPolicy() : NetFloodPolicy();
+}
+
+NetTimeoutPolicy NetConnectionProxy::GetTimeoutPolicy() const
+{
+    return _container ? _container->GetTimeoutPolicy() : NetTimeoutPolicy();
+}
+
+NetAdmissionPolicy NetConnectionProxy::GetAdmissionPolicy() const
+{
+    return _container ? _container->GetAdmissionPolicy() : NetAdmissionPolicy();
+}
+
+RecvMemoryBudget* NetConnectionProxy::GetRecvMemoryBudget() const
+{
+    return _container ? &_container->GetRecvMemoryBudget() : nullptr;
+}
+
 void NetConnectionProxy::Shutdown()
 {
     _isClosed = true;
@@ -1,16 +1,22 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include "reflib_composit_id.h"
 #include "reflib_net_worker.h"
+#include "reflib_net_flood_guard.h"
+#include "reflib_net_timer_wheel.h"
+#include "reflib_net_admission.h"
 
 namespace RefLib
 {
 
 class NetObj;
 class NetConnection;
+class NetConnectObserver;
 class NetConnectionMgr;
 class NetService;
+class RecvMemoryBudget;
 
 class NetConnectionProxy : public NetWorker
 {
@@ -20,15 +26,44 @@ public:
 
     bool Initialize(unsigned maxCnt, uint32 concurrency);
 
-    std::weak_ptr<NetConnection> RegisterCon();
+    std::weak_ptr<NetConnection> RegisterCon(bool pinned);
+    void UnregisterCon(const CompositId& id);
     std::weak_ptr<NetConnection> AllocNetCon(SOCKET sock);
     bool AllocNetCon(const CompositId& id, SOCKET sock);
     void FreeNetCon(const CompositId& id);
+    void RecycleNetCon(const CompositId& id);
+    void GetConnections(std::vector<std::shared_ptr<NetConnection>>& cons);
+    uint32 Materialize(uint32 count);
+
+    // hot restart: connections taken over with the ids they had before
+    void AdoptNetCons(const std::vector<CompositId>& ids, std::vector<std::shared_ptr<NetConnection>>& cons);
+    bool AttachNetCon(std::shared_ptr<NetConnection> con, SOCKET sock);
+
+    // port to associate con's socket with: its shard's under affinity, else the shared one
+    HANDLE AssignShard(NetConnection& con);
 
     virtual NetServiceChildType GetChildType() const { return NET_CTYPE_NA; };
     virtual bool Listen(unsigned port) { return false; }
     virtual bool Connect(const std::string& ipStr, uint32 port, std::weak_ptr<NetObj> obj) { return false; }
+    virtual bool Connect(const SOCKADDR_IN& addr, std::weak_ptr<NetObj> obj,
+        NetConnectObserver* observer, uint32 tag) { return false; }
     virtual void Shutdown();
+    virtual void StopAccepting() {}
+
+    // hot restart of the listen socket
+    virtual SOCKET GetListenSocket() const { return INVALID_SOCKET; }
+    virtual void ReleaseListenSocket() {}
+    virtual bool AdoptListenSocket(SOCKET sock) { return false; }
+    virtual void PrintStatistics();
+
+    // a connection admitted for addr has closed
+    virtual void ReleaseAdmission(uint32 addr) {}
+
+    NetRecvMode GetRecvMode() const;
+    NetFloodPolicy GetFloodPolicy() const;
+    NetTimeoutPolicy GetTimeoutPolicy() const;
+    NetAdmissionPolicy GetAdmissionPolicy() const;
+    RecvMemoryBudget* GetRecvMemoryBudget() const;
 
     void OnTerminated();
 
@@ -20,24 +20,33 @@ NetConnector::~NetConnector()
 
 bool NetConnector::Connect(const std::string& ipStr, uint32 port, std::weak_ptr<NetObj> obj)
 {
-    auto p = obj.lock();
-    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(p, "Connect: NetObj is null", false);
-    auto con = p->GetConn().lock();
-    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(con, "Connect: NetConnection is null", false);
-
     SOCKADDR_IN addr;
     addr.sin_family = AF_INET;
     addr.sin_port = htons(port);
     if (inet_pton(AF_INET, ipStr.c_str(), &addr.sin_addr) != 1)
     {
         DebugPrint("NetConnector Initialization: inet_pton failed due to the invalid ip address.");
+        if (auto p = obj.lock())
+            UnregisterCon(p->GetCompId());
         return false;
     }
 
-    HANDLE completionPort = g_network.GetCompletionPort();
-    if (completionPort == INVALID_HANDLE_VALUE)
+    return Connect(addr, obj, nullptr, 0);
+}
+
+bool NetConnector::Connect(const SOCKADDR_IN& addr, std::weak_ptr<NetObj> obj,
+    NetConnectObserver* observer, uint32 tag)
+{
+    auto p = obj.lock();
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(p, "Connect: NetObj is null", false);
+    auto con = p->GetConn().lock();
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(con, "Connect: NetConnection is null", false);
+
+    // until AllocNetCon the slot is only registered and goes back with UnregisterCon
+    if (g_network.GetCompletionPort() == INVALID_HANDLE_VALUE)
     {
         DebugPrint("Completion port is null");
+        UnregisterCon(con->GetCompId());
         return false;
     }
 
@@ -45,22 +54,44 @@ bool NetConnector::Connect(const std::string& ipStr, uint32 port, std::weak_ptr<
     if (sock == INVALID_SOCKET)
     {
         DebugPrint("Cannot create listen socket: %s", SocketGetLastErrorString().c_str());
+        UnregisterCon(con->GetCompId());
         return false;
     }
 
-    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(NetConnectionProxy::AllocNetCon(con->GetCompId(), sock),
-        "NetConnection is null", false);
+    // a failed claim leaves the slot registered; a failed Initialize has freed it
+    if (!NetConnectionProxy::AllocNetCon(con->GetCompId(), sock))
+    {
+        DebugPrint("Connect: cannot claim connection(%d)", con->GetCompId().GetSlotId());
+        closesocket(sock);
+        UnregisterCon(con->GetCompId());
+        return false;
+    }
 
     // Associate the new connection to our completion port
     HANDLE hrc = CreateIoCompletionPort((HANDLE)sock,
-        completionPort, (ULONG_PTR)con.get(), 0);
+        AssignShard(*con), (ULONG_PTR)con.get(), 0);
     if (hrc == NULL)
     {
         DebugPrint("OnAccept failed: %s", SocketGetLastErrorString().c_str());
+        con->ReleaseShard();
+        closesocket(sock);
+        FreeNetCon(con->GetCompId());
+        return false;
+    }
+
+    con->SetConnectObserver(observer, tag);
+
+    // nothing is queued for a connect that failed to start, so release it here
+    if (!p->Connect(sock, addr))
+    {
+        con->SetConnectObserver(nullptr, 0);
+        con->ReleaseShard();
+        closesocket(sock);
+        FreeNetCon(con->GetCompId());
         return false;
     }
 
-    return p->Connect(sock, addr);
+    return true;
 }
 
 } // namespace RefLib
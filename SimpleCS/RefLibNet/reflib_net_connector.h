@@ -19,7 +19,9 @@ public:
 
     virtual NetServiceChildType GetChildType() const { return NET_CTYPE_CONNECTOR; }
 
-    bool Connect(const std::string& ipStr, uint32 port, std::weak_ptr<NetObj> obj);
+    virtual bool Connect(const std::string& ipStr, uint32 port, std::weak_ptr<NetObj> obj) override;
+    virtual bool Connect(const SOCKADDR_IN& addr, std::weak_ptr<NetObj> obj,
+        NetConnectObserver* observer, uint32 tag) override;
 };
 
 } // namespace RefLib
@@ -5,11 +5,30 @@
 #define NETWORK_MAX_COMPLETION_THREAD_COUNT     32
 
 #define NETWORK_MAX_CONN                        5000
+#define NETWORK_CONN_FREE_CACHE                 256
+#define NET_OBJ_NO_HANDLE                       UINT64_MAX
+
+#define NET_ADMISSION_TABLE_SIZE                8192    // power of two
+#define NET_ADMISSION_MAX_PROBE                 16
+
+#define NET_TIMER_TICK_MSEC                     100
+#define NET_TIMER_WHEEL_SIZE                    512     // power of two
+
+#define NET_CLIENT_POOL_MAX_ENDPOINTS           64
+
+#define NET_HANDOFF_MAGIC                       0x44484652  // "RFHD"
+#define NET_HANDOFF_VERSION                     2
+#define NET_HANDOFF_PIPE_BUFFER                 (64*1024)
 
 #define MAX_PACKET_SIZE				            ((1024)*(64))
 #define DEF_SOCKET_BUFFER_SIZE  	            (10*MAX_PACKET_SIZE)
 #define MAX_SOCKET_BUFFER_SIZE  	            (20*MAX_PACKET_SIZE)
 #define MAX_SEND_ARRAY_SIZE                     10
+#define MAX_FRAME_BATCH_COUNT                   64
+
+#define NETWORK_RECV_DRAIN_BUDGET               16
+#define NETWORK_RECV_DRAIN_BYTES                (4*MAX_PACKET_SIZE)
+#define NETWORK_RECV_BUDGET_RESUME_PERCENT      75
 
 #define NET_STATUS_DISCONNECTED     0
 #define NET_STATUS_CONN_PENDING     (1 << 0)
@@ -17,12 +36,73 @@
 #define NET_STATUS_RECV_PENDING     (1 << 2)
 #define NET_STATUS_SEND_PENDING     (1 << 3)
 #define NET_STATUS_CLOSE_PENDING    (1 << 4)
+#define NET_STATUS_RECV_PAUSED      (1 << 5)
+#define NET_STATUS_HANDOFF          (1 << 6)
+#define NET_STATUS_HANDOFF_SEALED   (1 << 7)    // sends collected; later ones are refused
 
 enum NetCloseType
 {
     NET_CTYPE_CLIENT,
     NET_CTYPE_SYSTEM,
     NET_CTYPE_SHUTDOWN,
+    NET_CTYPE_TIMEOUT,
+    NET_CTYPE_DRAIN,
+    NET_CTYPE_HANDOFF,  // another process holds a duplicate; close only this handle
+};
+
+enum NetRecvMode
+{
+    NET_RECV_MODE_OVERLAPPED,   // one WSARecv per completion
+    NET_RECV_MODE_DRAIN,        // read nonblocking until empty or budget is spent, then re-arm
+};
+
+enum NetFloodAction
+{
+    NET_FLOOD_DROP,         // discard the frame before it is allocated
+    NET_FLOOD_PAUSE_READ,   // stop reading until the bucket refills
+    NET_FLOOD_DISCONNECT,
+};
+
+enum NetTimeoutType
+{
+    NET_TIMEOUT_HANDSHAKE,      // no inbound data since the connection was established
+    NET_TIMEOUT_IDLE,           // no inbound data for the idle period
+    NET_TIMEOUT_KEEPALIVE,      // heartbeat period elapsed, a ping is sent
+    NET_TIMEOUT_TYPE_CNT,
+};
+
+enum NetAdmitResult
+{
+    NET_ADMIT_OK,
+    NET_ADMIT_REJECT_RATE,          // source address connects too often
+    NET_ADMIT_REJECT_CONCURRENT,    // source address holds too many connections
+    NET_ADMIT_REJECT_TABLE_FULL,    // no room to track the source address
+    NET_ADMIT_REJECT_NO_CONN,       // out of connection slots
+    NET_ADMIT_REJECT_NO_ADDR,       // remote address unavailable
+    NET_ADMIT_RESULT_CNT,
+};
+
+enum NetConnectResult
+{
+    NET_CONNECT_OK,
+    NET_CONNECT_FAIL_REGISTER,  // no connection slot or NetObj
+    NET_CONNECT_FAIL_LAUNCH,    // socket, bind or ConnectEx failed
+    NET_CONNECT_FAIL_REMOTE,    // refused or timed out
+    NET_CONNECT_CANCELLED,
+    NET_CONNECT_RESULT_CNT,
+};
+
+enum NetControlType
+{
+    NET_CONTROL_PING = 1,
+    NET_CONTROL_PONG = 2,
+};
+
+enum NetHandoffRecordType
+{
+    NET_HANDOFF_END,
+    NET_HANDOFF_LISTENER,
+    NET_HANDOFF_CONNECTION,
 };
 
 enum NetServiceChildType
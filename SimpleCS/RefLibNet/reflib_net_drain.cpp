@@ -0,0 +1,107 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include "reflib_net_drain.h"
+#include "reflib_net_connection.h"
+#include "reflib_net_connection_proxy.h"
+
+namespace RefLib
+{
+
+NetDrainer::NetDrainer(const NetDrainPolicy& policy, NetConnectionProxy* proxy)
+    : _policy(policy)
+    , _proxy(proxy)
+{
+    if (_policy.batchIntervalMsec == 0)
+        _policy.batchIntervalMsec = 1;
+}
+
+void NetDrainer::CollectConnected(std::vector<std::shared_ptr<NetConnection>>& cons)
+{
+    std::vector<std::shared_ptr<NetConnection>> all;
+    _proxy->GetConnections(all);
+
+    cons.clear();
+    for (auto& con : all)
+    {
+        if (con->IsConnected())
+            cons.push_back(con);
+    }
+}
+
+bool NetDrainer::Run(NetDrainReport& report)
+{
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(_proxy, "NetDrainer: proxy is null", false);
+
+    uint64 start = GetTickCount64();
+    uint64 deadline = start + _policy.deadlineMsec;
+
+    _proxy->StopAccepting();
+
+    std::vector<std::shared_ptr<NetConnection>> cons;
+    CollectConnected(cons);
+    report.connections = cons.size();
+
+    DebugPrint("Drain: %llu connections, deadline %u msec", report.connections, _policy.deadlineMsec);
+
+    for (auto& con : cons)
+        con->OnDrain(deadline);
+
+    // give the NetObjs time to hand their players over
+    uint64 graceEnd = (std::min)(start + _policy.migrateGraceMsec, deadline);
+    while (GetTickCount64() < graceEnd)
+    {
+        CollectConnected(cons);
+        if (cons.empty())
+            break;
+
+        ::Sleep(_policy.batchIntervalMsec);
+    }
+
+    for (;;)
+    {
+        CollectConnected(cons);
+        if (cons.empty())
+            break;
+
+        uint64 now = GetTickCount64();
+        if (now >= deadline)
+        {
+            for (auto& con : cons)
+                con->Disconnect(NET_CTYPE_DRAIN);
+
+            report.forced += cons.size();
+            break;
+        }
+
+        // spread what is left evenly over the batches that still fit
+        uint64 batchesLeft = (std::max)((deadline - now) / _policy.batchIntervalMsec, 1ULL);
+        uint64 quota = (cons.size() + batchesLeft - 1) / batchesLeft;
+
+        for (auto& con : cons)
+        {
+            if (quota == 0)
+                break;
+
+            // a connection with sends in flight waits for a later batch
+            if (!con->IsSendIdle())
+                continue;
+
+            con->Disconnect(NET_CTYPE_DRAIN);
+            ++report.closed;
+            --quota;
+        }
+
+        ::Sleep(_policy.batchIntervalMsec);
+    }
+
+    report.migrated = report.connections - (std::min)(report.connections, report.closed + report.forced);
+    report.elapsedMsec = GetTickCount64() - start;
+
+    DebugPrint("Drain: done in %llu msec, migrated(%llu) closed(%llu) forced(%llu)",
+        report.elapsedMsec, report.migrated, report.closed, report.forced);
+
+    return report.forced == 0;
+}
+
+} // namespace RefLib
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "reflib_type_def.h"
+#include "reflib_net_def.h"
+
+namespace RefLib
+{
+
+class NetConnection;
+class NetConnectionProxy;
+
+struct NetDrainPolicy
+{
+    NetDrainPolicy()
+        : deadlineMsec(60 * 1000)
+        , migrateGraceMsec(5 * 1000)
+        , batchIntervalMsec(500)
+    {
+    }
+
+    uint32 deadlineMsec;        // everything still connected is closed at this point
+    uint32 migrateGraceMsec;    // time NetObjs get to move their players before closes start
+    uint32 batchIntervalMsec;   // pace of the close batches
+};
+
+struct NetDrainReport
+{
+    NetDrainReport() : elapsedMsec(0), connections(0), migrated(0), closed(0), forced(0) {}
+
+    uint64 elapsedMsec;
+    uint64 connections;     // connected when the drain started
+    uint64 migrated;        // closed by the peer during the drain
+    uint64 closed;          // closed by the drain after their sends were flushed
+    uint64 forced;          // still sending or connected at the deadline
+};
+
+// Stops accepting, asks every NetObj to migrate, then closes the remaining
+// connections in even batches spread over the time left to the deadline.
+// A connection is only closed early once its send queue is flushed.
+class NetDrainer
+{
+public:
+    NetDrainer(const NetDrainPolicy& policy, NetConnectionProxy* proxy);
+
+    bool Run(NetDrainReport& report);
+
+private:
+    void CollectConnected(std::vector<std::shared_ptr<NetConnection>>& cons);
+
+    NetDrainPolicy _policy;
+    NetConnectionProxy* _proxy;
+};
+
+} // namespace RefLib
@@ -0,0 +1,106 @@
+#include "stdafx.h"
+
+#include "reflib_net_flood_guard.h"
+
+namespace RefLib
+{
+
+FloodGuard::FloodGuard()
+    : _lastTick(0)
+    , _retryDelay(0)
+    , _violations(0)
+    , _droppedPackets(0)
+    , _droppedBytes(0)
+{
+    Reset(NetFloodPolicy(), 0);
+}
+
+void FloodGuard::Reset(const NetFloodPolicy& policy, uint64 now)
+{
+    _policy = policy;
+
+    // The packet bucket always holds at least one packet. The byte bucket is not
+    // floored: Admit lets a frame larger than all of it through from a full bucket.
+    _packets.rate = policy.packetsPerSec;
+    _packets.capacity = (std::max)(_packets.rate * policy.burstMsec, static_cast<uint64>(1000));
+    _packets.tokens = _packets.capacity;
+
+    _bytes.rate = policy.bytesPerSec;
+    _bytes.capacity = _bytes.rate * policy.burstMsec;
+    _bytes.tokens = _bytes.capacity;
+
+    _lastTick = now;
+    _retryDelay = 0;
+    _violations = 0;
+    _droppedPackets = 0;
+    _droppedBytes = 0;
+}
+
+void FloodGuard::Refill(Bucket& bucket, uint64 elapsed)
+{
+    if (bucket.rate == 0)
+        return;
+
+    if (elapsed >= bucket.capacity / bucket.rate)
+    {
+        bucket.tokens = bucket.capacity;
+        return;
+    }
+
+    bucket.tokens = (std::min)(bucket.tokens + bucket.rate * elapsed, bucket.capacity);
+}
+
+uint32 FloodGuard::GetDeficitMsec(const Bucket& bucket, uint64 cost)
+{
+    if (bucket.tokens >= cost)
+        return 0;
+
+    return static_cast<uint32>((cost - bucket.tokens + bucket.rate - 1) / bucket.rate);
+}
+
+bool FloodGuard::Admit(uint32 frameLen, uint64 now)
+{
+    if (!IsEnabled())
+        return true;
+
+    if (now > _lastTick)
+    {
+        uint64 elapsed = now - _lastTick;
+        Refill(_packets, elapsed);
+        Refill(_bytes, elapsed);
+        _lastTick = now;
+    }
+
+    uint64 packetCost = (_packets.rate > 0) ? 1000 : 0;
+    uint64 byteCost = (_bytes.rate > 0) ? static_cast<uint64>(frameLen) * 1000 : 0;
+
+    if (_packets.tokens >= packetCost && _bytes.tokens >= byteCost)
+    {
+        _packets.tokens -= packetCost;
+        _bytes.tokens -= byteCost;
+        return true;
+    }
+
+    // A frame larger than the whole byte bucket is admitted only from a full bucket.
+    if (byteCost > _bytes.capacity && _bytes.tokens == _bytes.capacity && _packets.tokens >= packetCost)
+    {
+        _packets.tokens -= packetCost;
+        _bytes.tokens = 0;
+        return true;
+    }
+
+    _violations++;
+    _retryDelay = (std::max)(
+        (_packets.rate > 0) ? GetDeficitMsec(_packets, packetCost) : 0,
+        (_bytes.rate > 0) ? GetDeficitMsec(_bytes, (std::min)(byteCost, _bytes.capacity)) : 0);
+
+    if (_policy.action == NET_FLOOD_DROP)
+    {
+        _droppedPackets++;
+        _droppedBytes += frameLen;
+    }
+
+    return false;
+}
+
+} // namespace RefLib
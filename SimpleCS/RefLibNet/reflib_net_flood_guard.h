@@ -0,0 +1,69 @@
+#pragma once
+
+#include "reflib_type_def.h"
+#include "reflib_net_def.h"
+
+namespace RefLib
+{
+
+struct NetFloodPolicy
+{
+    NetFloodPolicy()
+        : packetsPerSec(0)
+        , bytesPerSec(0)
+        , burstMsec(1000)
+        , action(NET_FLOOD_DROP)
+    {
+    }
+
+    uint32 packetsPerSec;   // 0 disables the packet rate limit
+    uint32 bytesPerSec;     // 0 disables the byte rate limit
+    uint32 burstMsec;       // bucket depth, in milliseconds worth of rate; at least one packet
+    NetFloodAction action;
+};
+
+// Per-connection packet and byte token buckets, checked once per inbound frame.
+class FloodGuard
+{
+public:
+    FloodGuard();
+
+    void Reset(const NetFloodPolicy& policy, uint64 now);
+
+    bool IsEnabled() const { return _policy.packetsPerSec > 0 || _policy.bytesPerSec > 0; }
+    NetFloodAction GetAction() const { return _policy.action; }
+
+    // O(1). Returns false if the frame exceeds either rate.
+    bool Admit(uint32 frameLen, uint64 now);
+
+    // milliseconds until the frame rejected last would be admitted
+    uint32 GetRetryDelay() const { return _retryDelay; }
+
+    uint64 GetViolations() const { return _violations; }
+    uint64 GetDroppedPackets() const { return _droppedPackets; }
+    uint64 GetDroppedBytes() const { return _droppedBytes; }
+
+private:
+    // Tokens are kept in units of 1/1000 so refill stays integral per millisecond.
+    struct Bucket
+    {
+        uint64 rate;
+        uint64 capacity;
+        uint64 tokens;
+    };
+
+    static void Refill(Bucket& bucket, uint64 elapsed);
+    static uint32 GetDeficitMsec(const Bucket& bucket, uint64 cost);
+
+    NetFloodPolicy _policy;
+    Bucket _packets;
+    Bucket _bytes;
+    uint64 _lastTick;
+    uint32 _retryDelay;
+
+    uint64 _violations;
+    uint64 _droppedPackets;
+    uint64 _droppedBytes;
+};
+
+} // namespace RefLib
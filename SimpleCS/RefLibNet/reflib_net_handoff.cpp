@@ -0,0 +1,468 @@
+#include "stdafx.h"
+
+#include "reflib_net_handoff.h"
+#include "reflib_net_connection.h"
+#include "reflib_net_connection_proxy.h"
+#include "reflib_net_api.h"
+
+namespace RefLib
+{
+
+// Both ends run the same build, so the records go over the pipe as is.
+struct NetHandoffHeader
+{
+    uint32 magic;
+    uint32 version;
+};
+
+struct NetHandoffRecord
+{
+    uint32 type;            // NetHandoffRecordType
+    uint32 slot;
+    uint32 salt;
+    uint32 unreadLen;       // receive ring bytes following the record
+    uint32 unsentLen;       // queued send bytes following the unread bytes
+    WSAPROTOCOL_INFOW info;
+};
+
+NetHandoff::NetHandoff(const NetHandoffPolicy& policy, NetConnectionProxy* proxy)
+    : _policy(policy)
+    , _proxy(proxy)
+{
+}
+
+bool NetHandoff::Send(const std::wstring& pipeName, NetHandoffReport& report)
+{
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(_proxy, "NetHandoff: proxy is null", false);
+
+    uint64 start = GetTickCount64();
+
+    HANDLE pipe = OpenPipe(pipeName);
+    if (pipe == INVALID_HANDLE_VALUE)
+        return false;
+
+    ULONG pid = 0;
+    NetHandoffHeader header = { NET_HANDOFF_MAGIC, NET_HANDOFF_VERSION };
+
+    bool ok = GetNamedPipeServerProcessId(pipe, &pid) != FALSE
+        && WritePipe(pipe, &header, sizeof(header))
+        && SendListener(pipe, pid, report);
+
+    if (ok && _policy.connections)
+        ok = SendConnections(pipe, pid, report);
+
+    if (ok)
+    {
+        NetHandoffRecord end;
+        memset(&end, 0, sizeof(end));
+        end.type = NET_HANDOFF_END;
+        ok = WritePipe(pipe, &end, sizeof(end));
+    }
+
+    CloseHandle(pipe);
+
+    report.elapsedMsec = GetTickCount64() - start;
+
+    DebugPrint("Handoff: sent listener(%llu) connections(%llu) unread(%llu bytes) unsent(%llu bytes), kept(%llu) in %llu msec",
+        report.listeners, report.connections, report.unreadBytes, report.unsentBytes, report.kept, report.elapsedMsec);
+
+    return ok;
+}
+
+// Without the listen socket the new process cannot take the port, so failing here aborts.
+bool NetHandoff::SendListener(HANDLE pipe, DWORD pid, NetHandoffReport& report)
+{
+    SOCKET sock = _proxy->GetListenSocket();
+    if (sock == INVALID_SOCKET)
+        return true;
+
+    NetHandoffRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = NET_HANDOFF_LISTENER;
+
+    if (!g_network.DuplicateSocket(sock, pid, record.info))
+        return false;
+
+    if (!WritePipe(pipe, &record, sizeof(record)))
+        return false;
+
+    _proxy->ReleaseListenSocket();
+    ++report.listeners;
+
+    return true;
+}
+
+// Every connection is quiesced at once and waited for together, so the
+// handoff takes about as long as the slowest in-flight I/O, not their sum.
+// Returns false only when the pipe breaks.
+bool NetHandoff::SendConnections(HANDLE pipe, DWORD pid, NetHandoffReport& report)
+{
+    std::vector<std::shared_ptr<NetConnection>> cons;
+    _proxy->GetConnections(cons);
+
+    std::vector<std::shared_ptr<NetConnection>> held;
+    for (auto& con : cons)
+    {
+        if (con->BeginHandoff())
+            held.push_back(con);
+    }
+
+    uint64 deadline = GetTickCount64() + _policy.quiesceMsec;
+    std::vector<char> settled(held.size(), 0);
+
+    for (size_t left = held.size(); left > 0; )
+    {
+        for (size_t i = 0; i < held.size(); ++i)
+        {
+            if (!settled[i] && held[i]->IsHandoffSettled())
+            {
+                settled[i] = 1;
+                --left;
+            }
+        }
+
+        if (left == 0 || GetTickCount64() >= deadline)
+            break;
+
+        ::Sleep(1);
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < held.size(); ++i)
+    {
+        // after a broken pipe the rest stay here as well
+        if (!settled[i] || !ok)
+        {
+            held[i]->CancelHandoff();
+            ++report.kept;
+            continue;
+        }
+
+        ok = SendConnection(pipe, pid, held[i], report);
+    }
+
+    return ok;
+}
+
+// A connection that closed meanwhile or cannot be duplicated stays with this process.
+// Returns false only when the pipe breaks.
+bool NetHandoff::SendConnection(HANDLE pipe, DWORD pid, std::shared_ptr<NetConnection> con, NetHandoffReport& report)
+{
+    std::vector<char> unread;
+    std::vector<char> unsent;
+    if (!con->CollectHandoff(unread, unsent))
+    {
+        con->CancelHandoff();
+        ++report.kept;
+        return true;
+    }
+
+    NetHandoffRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = NET_HANDOFF_CONNECTION;
+    record.slot = con->GetCompId().GetSlotId();
+    record.salt = con->GetCompId().GetSalt();
+    record.unreadLen = static_cast<uint32>(unread.size());
+    record.unsentLen = static_cast<uint32>(unsent.size());
+
+    if (!g_network.DuplicateSocket(con->GetSocket(), pid, record.info))
+    {
+        con->CancelHandoff();
+        ++report.kept;
+        return true;
+    }
+
+    if (!WritePipe(pipe, &record, sizeof(record))
+        || (!unread.empty() && !WritePipe(pipe, unread.data(), record.unreadLen))
+        || (!unsent.empty() && !WritePipe(pipe, unsent.data(), record.unsentLen)))
+    {
+        con->CancelHandoff();
+        ++report.kept;
+        return false;
+    }
+
+    // the duplicate holds the connection now
+    con->EndHandoff();
+
+    ++report.connections;
+    report.unreadBytes += unread.size();
+    report.unsentBytes += unsent.size();
+
+    return true;
+}
+
+bool NetHandoff::Receive(const std::wstring& pipeName, NetHandoffReport& report)
+{
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(_proxy, "NetHandoff: proxy is null", false);
+
+    uint64 start = GetTickCount64();
+
+    HANDLE pipe = AcceptPipe(pipeName);
+    if (pipe == INVALID_HANDLE_VALUE)
+        return false;
+
+    NetHandoffHeader header;
+    if (!ReadPipe(pipe, &header, sizeof(header))
+        || header.magic != NET_HANDOFF_MAGIC || header.version != NET_HANDOFF_VERSION)
+    {
+        DebugPrint("Handoff: unexpected header");
+        CloseHandle(pipe);
+        return false;
+    }
+
+    SOCKET listenSock = INVALID_SOCKET;
+    std::vector<Adopted> adopted;
+    bool ok = true;
+
+    for (;;)
+    {
+        NetHandoffRecord record;
+        if (!ReadPipe(pipe, &record, sizeof(record)))
+        {
+            ok = false;
+            break;
+        }
+
+        if (record.type == NET_HANDOFF_END)
+            break;
+
+        SOCKET sock = g_network.AdoptSocket(record.info);
+
+        if (record.type == NET_HANDOFF_LISTENER && listenSock == INVALID_SOCKET)
+        {
+            // the sender has already let go of the port, so nobody listens on it now
+            if (sock == INVALID_SOCKET)
+            {
+                DebugPrint("Handoff: cannot adopt the listen socket");
+                ok = false;
+            }
+
+            listenSock = sock;
+            continue;
+        }
+
+        if (record.type != NET_HANDOFF_CONNECTION)
+        {
+            DebugPrint("Handoff: unexpected record(%d)", record.type);
+            if (sock != INVALID_SOCKET)
+                closesocket(sock);
+            ok = false;
+            break;
+        }
+
+        adopted.emplace_back(CompositId(record.slot, record.salt), sock);
+        adopted.back().unread.resize(record.unreadLen);
+        adopted.back().unsent.resize(record.unsentLen);
+
+        // the sender keeps a connection it could not finish writing
+        if ((record.unreadLen > 0 && !ReadPipe(pipe, adopted.back().unread.data(), record.unreadLen))
+            || (record.unsentLen > 0 && !ReadPipe(pipe, adopted.back().unsent.data(), record.unsentLen)))
+        {
+            if (sock != INVALID_SOCKET)
+                closesocket(sock);
+            adopted.pop_back();
+            ok = false;
+            break;
+        }
+    }
+
+    CloseHandle(pipe);
+
+    if (!ok)
+        DebugPrint("Handoff: stream from the old process broke off");
+
+    // Everything fully received was already closed by the sender, so it is
+    // taken over even if the stream broke off. Connections go first: their
+    // slots must not be handed to new accepts.
+    AdoptConnections(adopted, report);
+
+    if (listenSock != INVALID_SOCKET)
+    {
+        if (_proxy->AdoptListenSocket(listenSock))
+        {
+            ++report.listeners;
+        }
+        else
+        {
+            closesocket(listenSock);
+            ok = false;
+        }
+    }
+
+    report.elapsedMsec = GetTickCount64() - start;
+
+    DebugPrint("Handoff: took over listener(%llu) connections(%llu) unread(%llu bytes) unsent(%llu bytes), lost(%llu) in %llu msec",
+        report.listeners, report.connections, report.unreadBytes, report.unsentBytes, report.kept, report.elapsedMsec);
+
+    return ok;
+}
+
+void NetHandoff::AdoptConnections(std::vector<Adopted>& adopted, NetHandoffReport& report)
+{
+    std::vector<CompositId> ids;
+    for (auto& entry : adopted)
+        ids.push_back(entry.id);
+
+    std::vector<std::shared_ptr<NetConnection>> cons;
+    _proxy->AdoptNetCons(ids, cons);
+
+    for (size_t i = 0; i < adopted.size(); ++i)
+    {
+        Adopted& entry = adopted[i];
+        auto& con = cons[i];
+
+        if (entry.sock == INVALID_SOCKET)
+        {
+            if (con)
+                _proxy->FreeNetCon(con->GetCompId());
+            ++report.kept;
+            continue;
+        }
+
+        if (!con)
+        {
+            DebugPrint("Handoff: slot(%d) is already in use", entry.id.GetSlotId());
+            closesocket(entry.sock);
+            ++report.kept;
+            continue;
+        }
+
+        if (!_proxy->AttachNetCon(con, entry.sock)
+            || !g_network.AssociateAdopted(entry.sock, _proxy->AssignShard(*con), (ULONG_PTR)con.get()))
+        {
+            con->ReleaseShard();
+            closesocket(entry.sock);
+            _proxy->FreeNetCon(con->GetCompId());
+            ++report.kept;
+            continue;
+        }
+
+        report.unreadBytes += entry.unread.size();
+        report.unsentBytes += entry.unsent.size();
+
+        con->SetAdoptedData(std::move(entry.unread));
+        con->SetAdoptedSend(std::move(entry.unsent));
+        con->OnConnected();
+
+        ++report.connections;
+    }
+}
+
+// The new process creates the pipe, possibly after this one started waiting.
+HANDLE NetHandoff::OpenPipe(const std::wstring& pipeName)
+{
+    uint64 deadline = GetTickCount64() + _policy.connectMsec;
+
+    for (;;)
+    {
+        HANDLE pipe = CreateFileW(pipeName.c_str(), GENERIC_WRITE | FILE_READ_ATTRIBUTES,
+            0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (pipe != INVALID_HANDLE_VALUE)
+            return pipe;
+
+        DWORD error = GetLastError();
+        if ((error != ERROR_FILE_NOT_FOUND && error != ERROR_PIPE_BUSY) || GetTickCount64() >= deadline)
+        {
+            DebugPrint("Handoff: cannot open pipe: %d", error);
+            return INVALID_HANDLE_VALUE;
+        }
+
+        ::Sleep(100);
+    }
+}
+
+HANDLE NetHandoff::AcceptPipe(const std::wstring& pipeName)
+{
+    HANDLE pipe = CreateNamedPipeW(pipeName.c_str(),
+        PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        1, 0, NET_HANDOFF_PIPE_BUFFER, 0, nullptr);
+    if (pipe == INVALID_HANDLE_VALUE)
+    {
+        DebugPrint("Handoff: CreateNamedPipe failed: %d", GetLastError());
+        return INVALID_HANDLE_VALUE;
+    }
+
+    OVERLAPPED ol;
+    memset(&ol, 0, sizeof(ol));
+    ol.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    bool connected = ConnectNamedPipe(pipe, &ol) != FALSE;
+    DWORD error = GetLastError();
+    DWORD bytes = 0;
+
+    if (!connected && error == ERROR_PIPE_CONNECTED)
+    {
+        connected = true;
+    }
+    else if (!connected && error == ERROR_IO_PENDING)
+    {
+        if (WaitForSingleObject(ol.hEvent, _policy.connectMsec) == WAIT_OBJECT_0)
+        {
+            connected = GetOverlappedResult(pipe, &ol, &bytes, FALSE) != FALSE;
+        }
+        else
+        {
+            CancelIo(pipe);
+            GetOverlappedResult(pipe, &ol, &bytes, TRUE);
+        }
+    }
+
+    CloseHandle(ol.hEvent);
+
+    if (!connected)
+    {
+        DebugPrint("Handoff: the old process did not connect");
+        CloseHandle(pipe);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return pipe;
+}
+
+bool NetHandoff::ReadPipe(HANDLE pipe, void* data, DWORD len)
+{
+    OVERLAPPED ol;
+    memset(&ol, 0, sizeof(ol));
+    ol.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    char* pos = static_cast<char*>(data);
+    bool ok = true;
+
+    while (ok && len > 0)
+    {
+        DWORD bytes = 0;
+        if (!ReadFile(pipe, pos, len, &bytes, &ol) && GetLastError() != ERROR_IO_PENDING)
+            ok = false;
+        else if (!GetOverlappedResult(pipe, &ol, &bytes, TRUE) || bytes == 0)
+            ok = false;
+
+        pos += bytes;
+        len -= bytes;
+    }
+
+    CloseHandle(ol.hEvent);
+    return ok;
+}
+
+bool NetHandoff::WritePipe(HANDLE pipe, const void* data, DWORD len)
+{
+    const char* pos = static_cast<const char*>(data);
+
+    while (len > 0)
+    {
+        DWORD bytes = 0;
+        if (!WriteFile(pipe, pos, len, &bytes, nullptr) || bytes == 0)
+        {
+            DebugPrint("Handoff: pipe write failed: %d", GetLastError());
+            return false;
+        }
+
+        pos += bytes;
+        len -= bytes;
+    }
+
+    return true;
+}
+
+} // namespace RefLib
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "reflib_type_def.h"
+#include "reflib_net_def.h"
+#include "reflib_composit_id.h"
+
+namespace RefLib
+{
+
+class NetConnection;
+class NetConnectionProxy;
+
+struct NetHandoffPolicy
+{
+    NetHandoffPolicy()
+        : connectMsec(10 * 1000)
+        , quiesceMsec(1000)
+        , connections(true)
+    {
+    }
+
+    uint32 connectMsec;     // how long either side waits for the other on the pipe
+    uint32 quiesceMsec;     // one wait for every connection's in-flight I/O to settle
+    bool connections;       // hand over live connections, not only the listen socket
+};
+
+struct NetHandoffReport
+{
+    NetHandoffReport() : elapsedMsec(0), listeners(0), connections(0), kept(0), unreadBytes(0), unsentBytes(0) {}
+
+    uint64 elapsedMsec;
+    uint64 listeners;
+    uint64 connections;     // handed over, or taken over on the receiving side
+    uint64 kept;            // left with the old process, or not taken over
+    uint64 unreadBytes;     // partial frames moved along with the connections
+    uint64 unsentBytes;     // queued sends moved along with the connections
+};
+
+// Zero downtime restart. The old process duplicates its listen socket, and
+// optionally its connections, for the new process and sends them over a named
+// pipe along with each connection's CompositId, unread receive bytes and
+// queued sends.
+// The new process owns the pipe, so the old one learns whom to duplicate for.
+class NetHandoff
+{
+public:
+    NetHandoff(const NetHandoffPolicy& policy, NetConnectionProxy* proxy);
+
+    // old process: closes its own handles as each socket is sent
+    bool Send(const std::wstring& pipeName, NetHandoffReport& report);
+    // new process: adopts the connections, then starts accepting
+    bool Receive(const std::wstring& pipeName, NetHandoffReport& report);
+
+private:
+    struct Adopted
+    {
+        Adopted(const CompositId& id, SOCKET sock) : id(id), sock(sock) {}
+
+        CompositId id;
+        SOCKET sock;
+        std::vector<char> unread;
+        std::vector<char> unsent;
+    };
+
+    HANDLE OpenPipe(const std::wstring& pipeName);
+    HANDLE AcceptPipe(const std::wstring& pipeName);
+    static bool ReadPipe(HANDLE pipe, void* data, DWORD len);
+    static bool WritePipe(HANDLE pipe, const void* data, DWORD len);
+
+    bool SendListener(HANDLE pipe, DWORD pid, NetHandoffReport& report);
+    bool SendConnections(HANDLE pipe, DWORD pid, NetHandoffReport& report);
+    bool SendConnection(HANDLE pipe, DWORD pid, std::shared_ptr<NetConnection> con, NetHandoffReport& report);
+    void AdoptConnections(std::vector<Adopted>& adopted, NetHandoffReport& report);
+
+    NetHandoffPolicy _policy;
+    NetConnectionProxy* _proxy;
+};
+
+} // namespace RefLib
@@ -0,0 +1,50 @@
+#include "stdafx.h"
+
+#include "reflib_net_heartbeat.h"
+
+namespace RefLib
+{
+
+void RttEstimator::Reset()
+{
+    _srtt = 0;
+    _rttVar = 0;
+    _lastRtt = 0;
+    _samples = 0;
+}
+
+void RttEstimator::AddSample(uint64 rttUsec)
+{
+    _lastRtt = rttUsec;
+
+    if (_samples++ == 0)
+    {
+        _srtt = rttUsec;
+        _rttVar = rttUsec / 2;
+        return;
+    }
+
+    uint64 srtt = _srtt;
+    uint64 delta = (srtt > rttUsec) ? srtt - rttUsec : rttUsec - srtt;
+
+    // rttvar = 3/4 rttvar + 1/4 |srtt - r|, srtt = 7/8 srtt + 1/8 r
+    _rttVar = (_rttVar * 3 + delta) / 4;
+    _srtt = (srtt * 7 + rttUsec) / 8;
+}
+
+uint64 RttEstimator::GetMicroTick()
+{
+    static const uint64 frequency = []() {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        return static_cast<uint64>(freq.QuadPart);
+    }();
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    uint64 ticks = static_cast<uint64>(counter.QuadPart);
+    return (ticks / frequency) * 1000000 + (ticks % frequency) * 1000000 / frequency;
+}
+
+} // namespace RefLib
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include "reflib_type_def.h"
+#include "reflib_net_def.h"
+
+namespace RefLib
+{
+
+// Content of a PACKET_CONTROL_TAG frame.
+#pragma pack(push, 1)
+struct NetControlFrame
+{
+    uint16 type;        // NetControlType
+    uint16 reserved;
+    uint64 timestamp;   // sender's RttEstimator::GetMicroTick, echoed back in the pong
+};
+#pragma pack(pop)
+
+// Smoothed round trip time and its mean deviation (RFC 6298), in microseconds.
+// Samples come from the receive path only; readers may be on any thread.
+class RttEstimator
+{
+public:
+    RttEstimator() { Reset(); }
+
+    void Reset();
+    void AddSample(uint64 rttUsec);
+
+    uint64 GetSmoothed() const { return _srtt; }
+    uint64 GetVariance() const { return _rttVar; }
+    uint64 GetLast() const { return _lastRtt; }
+    uint64 GetSampleCount() const { return _samples; }
+
+    static uint64 GetMicroTick();
+
+private:
+    std::atomic<uint64> _srtt;
+    std::atomic<uint64> _rttVar;
+    std::atomic<uint64> _lastRtt;
+    std::atomic<uint64> _samples;
+};
+
+} // namespace RefLib
@@ -14,6 +14,7 @@ namespace RefLib
 
 NetListener::NetListener(NetService* container)
     : NetConnectionProxy(container)
+    , _accepting(false)
 {
 }
 
@@ -55,7 +56,35 @@ bool NetListener::Listen(unsigned port)
     if (!g_network.Listen(GetSocket(), saLocal))
         return false;
 
-    _acceptor = std::make_unique<NetAcceptor>(reinterpret_cast<NetSocketBase*>(this), completionPort);
+    return StartAccepting();
+}
+
+// A listen socket handed over by the previous process is already bound and listening.
+bool NetListener::AdoptListenSocket(SOCKET sock)
+{
+    HANDLE completionPort = g_network.GetCompletionPort();
+    if (completionPort == INVALID_HANDLE_VALUE)
+    {
+        DebugPrint("Completion port is null");
+        return false;
+    }
+
+    SetSocket(sock);
+
+    if (!g_network.AssociateAdopted(GetSocket(), completionPort, (ULONG_PTR)this))
+        return false;
+
+    return StartAccepting();
+}
+
+bool NetListener::StartAccepting()
+{
+    if (!_admission.Initialize(GetAdmissionPolicy()))
+        return false;
+
+    _accepting = true;
+
+    _acceptor = std::make_unique<NetAcceptor>(reinterpret_cast<NetSocketBase*>(this));
     _acceptor->Accepts();
 
     return true;
@@ -64,7 +93,25 @@ bool NetListener::Listen(unsigned port)
 void NetListener::OnCompletionFailure(NetCompletionOP* bufObj, DWORD bytesTransfered, int error)
 {
     DebugPrint("NetListener] Socket(%d), OP(%d), Error(%d)", bufObj->client, bufObj->op, error);
-    return;
+
+    if (bufObj->op != NetCompletionOP::OP_ACCEPT)
+        return;
+
+    // a client that reset mid-handshake; the accept goes back in flight
+    if (_accepting)
+    {
+        _acceptor->Reject(bufObj);
+        return;
+    }
+
+    // accepts fail once the listen socket is closed
+    if (bufObj->client != INVALID_SOCKET)
+    {
+        closesocket(bufObj->client);
+        bufObj->client = INVALID_SOCKET;
+    }
+
+    OnDisconnected();
 }
 
 void NetListener::OnCompletionSuccess(NetCompletionOP* bufObj, DWORD bytesTransfered)
@@ -83,11 +130,95 @@ void NetListener::OnCompletionSuccess(NetCompletionOP* bufObj, DWORD bytesTransf
     }
 }
 
+// Admission runs on the raw accepted socket, before a connection slot is taken.
 void NetListener::OnAccept(NetCompletionOP* bufObj)
 {
+    if (!_accepting)
+    {
+        closesocket(bufObj->client);
+        bufObj->client = INVALID_SOCKET;
+        return;
+    }
+
+    uint32 addr = 0;
+
+    if (_admission.IsEnabled())
+    {
+        SOCKADDR_IN remote;
+        if (!g_network.GetAcceptAddr(reinterpret_cast<AcceptBuffer*>(bufObj), remote))
+        {
+            _admission.OnReject(NET_ADMIT_REJECT_NO_ADDR);
+            _acceptor->Reject(bufObj);
+            return;
+        }
+
+        addr = static_cast<uint32>(remote.sin_addr.s_addr);
+        if (_admission.Admit(addr, GetTickCount64()) != NET_ADMIT_OK)
+        {
+            _acceptor->Reject(bufObj);
+            return;
+        }
+    }
+
     auto con = NetConnectionProxy::AllocNetCon(bufObj->client).lock();
-    if (con)
-        _acceptor->OnAccept(con, bufObj);
+    if (!con)
+    {
+        _admission.Release(addr);
+        _admission.OnReject(NET_ADMIT_REJECT_NO_CONN);
+        _acceptor->Reject(bufObj);
+        return;
+    }
+
+    con->SetAdmittedAddr(addr);
+    if (_acceptor->OnAccept(con, bufObj, AssignShard(*con)))
+        return;
+
+    // as NetConnector::Connect does, and the accept goes back in flight
+    con->ReleaseShard();
+    con->SetAdmittedAddr(0);
+    _admission.Release(addr);
+    _acceptor->Reject(bufObj);
+    FreeNetCon(con->GetCompId());
+}
+
+void NetListener::PrintStatistics()
+{
+    NetConnectionProxy::PrintStatistics();
+
+    if (_admission.IsEnabled())
+        _admission.PrintStatistics();
+}
+
+void NetListener::ReleaseAdmission(uint32 addr)
+{
+    _admission.Release(addr);
+}
+
+// Closing the listen socket refuses new connections at the TCP level
+// and fails the accepts still in flight.
+void NetListener::StopAccepting()
+{
+    if (!_accepting.exchange(false))
+        return;
+
+    DebugPrint("NetListener] Stop accepting");
+    Disconnect(NET_CTYPE_SHUTDOWN);
+}
+
+SOCKET NetListener::GetListenSocket() const
+{
+    return _accepting ? GetSocket() : INVALID_SOCKET;
+}
+
+// The new process holds a duplicate and keeps listening; only this handle
+// is closed, which fails the accepts posted on it.
+void NetListener::ReleaseListenSocket()
+{
+    if (!_accepting.exchange(false))
+        return;
+
+    DebugPrint("NetListener] Listen socket handed off");
+    Disconnect(NET_CTYPE_HANDOFF);
 }
 
 void NetListener::Shutdown()
@@ -4,6 +4,7 @@
 #include "reflib_net_completion.h"
 #include "reflib_net_socket_base.h"
 #include "reflib_net_connection_proxy.h"
+#include "reflib_net_admission.h"
 
 namespace RefLib
 {
@@ -19,6 +20,15 @@ public:
 
     virtual NetServiceChildType GetChildType() const { return NET_CTYPE_LISTENER; }
     virtual void Shutdown() override;
+    virtual void StopAccepting() override;
+    virtual void ReleaseAdmission(uint32 addr) override;
+    virtual void PrintStatistics() override;
+
+    virtual SOCKET GetListenSocket() const override;
+    virtual void ReleaseListenSocket() override;
+    virtual bool AdoptListenSocket(SOCKET sock) override;
+
+    const NetAdmissionTable& GetAdmissionTable() const { return _admission; }
 
     bool Listen(unsigned port);
 
@@ -26,9 +36,12 @@ public:
     virtual void OnCompletionFailure(NetCompletionOP* bufObj, DWORD bytesTransfered, int error) override;
 
 private:
+    bool StartAccepting();
     void OnAccept(NetCompletionOP* bufObj);
 
     std::unique_ptr<NetAcceptor> _acceptor;
+    NetAdmissionTable _admission;
+    std::atomic<bool> _accepting;
 };
 
 } // namespace RefLib
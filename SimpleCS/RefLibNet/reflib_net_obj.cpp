@@ -5,16 +5,28 @@
 #include "reflib_net_service.h"
 #include "reflib_def.h"
 #include "reflib_memory_pool.h"
+#include "reflib_net_recv_budget.h"
 
 namespace RefLib
 {
 
+namespace
+{
+    const uint32 POST_REF_HELD = 0x40000000;    // _postRef is set
+    const uint32 POST_REF_BUSY = 0x20000000;    // the last release is clearing _postRef
+    const uint32 POST_COUNT_MASK = 0x1FFFFFFF;
+}
+
 NetObj::NetObj(std::weak_ptr<NetService> container)
     : _comPort(INVALID_HANDLE_VALUE)
+    , _queuedBytes(0)
+    , _recvBudget(nullptr)
+    , _posts(0)
 {
     if (auto p = container.lock())
     {
         _comPort = p->GetCompletionPort();
+        _recvBudget = &p->GetRecvMemoryBudget();
         _container = container;
     }
 }
@@ -49,10 +61,32 @@ void NetObj::Reset()
     REFLIB_ASSERT(_recvPackets.empty(), "Reset NetObj: recv packet queue is not empty");
     while (_recvPackets.try_pop(buffer))
     {
+        ReleaseQueuedBytes(buffer);
         g_memoryPool.FreeBuffer(buffer);
     }
 }
 
+void NetObj::ReleaseQueuedBytes(MemoryBlock* packet)
+{
+    uint64 len = packet->GetDataLen();
+
+    _queuedBytes.fetch_sub(len);
+    if (_recvBudget)
+        _recvBudget->Release(RECV_MEM_PACKET, len);
+}
+
+uint64 NetObj::GetSmoothedRtt() const
+{
+    auto p = _con.lock();
+    return p ? p->GetRtt().GetSmoothed() : 0;
+}
+
+uint64 NetObj::GetRttJitter() const
+{
+    auto p = _con.lock();
+    return p ? p->GetRtt().GetVariance() : 0;
+}
+
 bool NetObj::Connect(SOCKET sock, const SOCKADDR_IN& addr)
 {
     auto p = _con.lock();
@@ -78,18 +112,88 @@ void NetObj::OnDisconnected()
 // called by network thead
 bool NetObj::RecvPacket(MemoryBlock* packet)
 {
+    uint64 len = packet->GetDataLen();
+
+    _queuedBytes.fetch_add(len);
+    if (_recvBudget)
+        _recvBudget->Charge(RECV_MEM_PACKET, len);
+
     _recvPackets.push(packet);
 
-    ::PostQueuedCompletionStatus(_comPort, 0, (ULONG_PTR)this, NULL);
+    uint32 posts = _posts.load();
+    for (;;)
+    {
+        if (posts & POST_REF_BUSY)
+        {
+            // the previous last release is still dropping its reference
+            YieldProcessor();
+            posts = _posts.load();
+            continue;
+        }
+
+        if (posts & POST_REF_HELD)
+        {
+            if (_posts.compare_exchange_weak(posts, posts + 1))
+                break;
+            continue;
+        }
+
+        // first wakeup: no one else touches _postRef until this one is consumed
+        if (_posts.compare_exchange_weak(posts, POST_REF_HELD | 1))
+        {
+            _postRef = shared_from_this();
+            break;
+        }
+    }
+
+    if (!::PostQueuedCompletionStatus(_comPort, 0, (ULONG_PTR)this, NULL))
+    {
+        DebugPrint("RecvPacket: PostQueuedCompletionStatus failed: %d", GetLastError());
+        ReleasePost();
+    }
 
     return true;
 }
 
+void NetObj::ReleasePost()
+{
+    uint32 posts = _posts.load();
+    for (;;)
+    {
+        REFLIB_ASSERT((posts & POST_COUNT_MASK) > 0, "ReleasePost without a post");
+
+        if ((posts & POST_COUNT_MASK) > 1)
+        {
+            if (_posts.compare_exchange_weak(posts, posts - 1))
+                return;
+            continue;
+        }
+
+        if (_posts.compare_exchange_weak(posts, POST_REF_BUSY))
+            break;
+    }
+
+    std::shared_ptr<NetObj> ref;
+    ref.swap(_postRef);
+    _posts.store(0);
+
+    // ref may be the last reference; nothing of this object is touched after it
+}
+
+bool NetObj::IsDispatchIdle() const
+{
+    // ReleasePost follows OnRecvPacket, so a zero count means the handler is done
+    return (_posts.load() & POST_COUNT_MASK) == 0 && _recvPackets.empty();
+}
+
 MemoryBlock* NetObj::PopRecvPacket()
 {
     MemoryBlock* buffer = nullptr;
     if (_recvPackets.try_pop(buffer))
+    {
+        ReleaseQueuedBytes(buffer);
         return buffer;
+    }
 
     return nullptr;
 }
@@ -100,4 +204,10 @@ void NetObj::Send(char* data, uint16 dataLen)
         p->Send(data, dataLen);
 }
 
+void NetObj::Send(MemoryBlockPtr packet)
+{
+    if (auto p = _con.lock())
+        p->Send(std::move(packet));
+}
+
 } //namespace RefLib
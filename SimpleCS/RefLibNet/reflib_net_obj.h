@@ -1,16 +1,19 @@
 #pragma once
 
 #include <memory>
+#include <atomic>
 #include <concurrent_queue.h>
 #include "reflib_composit_id.h"
+#include "reflib_memory_block_ptr.h"
+#include "reflib_safelock.h"
 
 namespace RefLib
 {
 class NetConnection;
 class NetService;
-class MemoryBlock;
+class RecvMemoryBudget;
 
-class NetObj
+class NetObj : public std::enable_shared_from_this<NetObj>
 {
 public:
     NetObj(std::weak_ptr<NetService> container);
@@ -23,16 +26,49 @@ public:
     virtual bool Connect(SOCKET sock, const SOCKADDR_IN& addr);
     virtual bool OnRecvPacket()=0;
     virtual void Send(char* data, uint16 dataLen);
+    virtual void Send(MemoryBlockPtr packet);
     virtual void OnConnected();
     virtual void OnDisconnected();
 
+    // Called by the connection with its own id; forward to OnConnected and
+    // OnDisconnected unless overridden to filter by id.
+    virtual void NotifyConnected(const CompositId& id) { OnConnected(); }
+    virtual void NotifyDisconnected(const CompositId& id) { OnDisconnected(); }
+
+    // The service is draining for a restart and closes this connection by
+    // deadline (GetTickCount64). Tell the client where to reconnect here.
+    virtual void OnDrain(uint64 deadline) {}
+
     bool RecvPacket(MemoryBlock* packet);
+    // called by the logic thread after OnRecvPacket, once per wakeup RecvPacket posted
+    void ReleasePost();
+    // the logic port packets are posted to; the connection's shard's under affinity
+    void SetCompletionPort(HANDLE comPort) { _comPort = comPort; }
     MemoryBlock* PopRecvPacket();
 
+    uint64 GetQueuedRecvBytes() const { return _queuedBytes; }
+    // every packet popped and its OnRecvPacket returned
+    bool IsDispatchIdle() const;
+
+    // heartbeat round trip of the connection in microseconds; 0 before the first pong
+    uint64 GetSmoothedRtt() const;
+    uint64 GetRttJitter() const;
+
 private:
     void Reset();
 
+    void ReleaseQueuedBytes(MemoryBlock* packet);
+
     Concurrency::concurrent_queue<MemoryBlock*> _recvPackets;
+    std::atomic<uint64> _queuedBytes;
+    RecvMemoryBudget* _recvBudget;
+
+    // The logic port holds a raw pointer, so the object keeps itself alive
+    // while any wakeup is queued, even after the service has retired it.
+    // _posts counts queued wakeups; only the 0->1 and 1->0 transitions touch
+    // _postRef, flagged in the high bits of _posts.
+    std::atomic<uint32> _posts;
+    std::shared_ptr<NetObj> _postRef;
 
     HANDLE _comPort;
     std::weak_ptr<NetConnection> _con;
@@ -0,0 +1,139 @@
+#include "stdafx.h"
+
+#include "reflib_net_obj_table.h"
+#include "reflib_net_obj.h"
+
+namespace RefLib
+{
+
+NetObjTable::NetObjTable()
+    : _capacity(0)
+{
+}
+
+NetObjTable::~NetObjTable()
+{
+}
+
+bool NetObjTable::Initialize(uint32 capacity)
+{
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(!_entries, "NetObjTable is already initialized", false);
+
+    _entries.reset(new Entry[capacity]);
+    _capacity = capacity;
+
+    return true;
+}
+
+void NetObjTable::WaitReaders(const Entry& entry)
+{
+    while (entry.readers.load() != 0)
+    {
+        YieldProcessor();
+    }
+}
+
+bool NetObjTable::Attach(uint32 slot, std::shared_ptr<NetObj> obj)
+{
+    if (slot < 0 || slot >= _capacity)
+        return false;
+
+    Entry& entry = _entries[slot];
+    {
+        SafeLock::Owner lock(_writeLock);
+
+        // a published object is still visible to lookups
+        if (entry.handle.load() != NET_OBJ_NO_HANDLE)
+            return false;
+
+        WaitReaders(entry);
+        entry.obj.swap(obj);
+    }
+
+    // the replaced object, if any, is released outside the lock
+    return true;
+}
+
+void NetObjTable::Detach(uint32 slot, const std::shared_ptr<NetObj>& obj)
+{
+    if (slot < 0 || slot >= _capacity)
+        return;
+
+    Entry& entry = _entries[slot];
+
+    std::shared_ptr<NetObj> detached;
+    {
+        SafeLock::Owner lock(_writeLock);
+        if (entry.obj == obj && entry.handle.load() == NET_OBJ_NO_HANDLE)
+        {
+            WaitReaders(entry);
+            entry.obj.swap(detached);
+        }
+    }
+}
+
+bool NetObjTable::Publish(const CompositId& id)
+{
+    uint32 slot = id.GetSlotId();
+    if (slot < 0 || slot >= _capacity)
+        return false;
+
+    Entry& entry = _entries[slot];
+
+    SafeLock::Owner lock(_writeLock);
+    if (!entry.obj)
+        return false;
+
+    entry.handle.store(id.GetIndex());
+    return true;
+}
+
+bool NetObjTable::Retire(const CompositId& id, bool keep)
+{
+    uint32 slot = id.GetSlotId();
+    if (slot < 0 || slot >= _capacity)
+        return false;
+
+    Entry& entry = _entries[slot];
+
+    // only the connection that published the handle may retire it
+    uint64 handle = id.GetIndex();
+    if (!entry.handle.compare_exchange_strong(handle, NET_OBJ_NO_HANDLE))
+        return false;
+
+    std::shared_ptr<NetObj> retired;
+    if (!keep)
+    {
+        SafeLock::Owner lock(_writeLock);
+        WaitReaders(entry);
+        entry.obj.swap(retired);
+    }
+
+    return true;
+}
+
+std::shared_ptr<NetObj> NetObjTable::Find(const CompositId& id) const
+{
+    uint32 slot = id.GetSlotId();
+    if (slot < 0 || slot >= _capacity)
+        return std::shared_ptr<NetObj>();
+
+    const Entry& entry = _entries[slot];
+    uint64 handle = id.GetIndex();
+
+    if (entry.handle.load() != handle)
+        return std::shared_ptr<NetObj>();
+
+    // announce the read, then check the handle again: a writer either sees the
+    // count and waits, or has already unpublished and the check fails
+    std::shared_ptr<NetObj> obj;
+
+    entry.readers.fetch_add(1);
+    if (entry.handle.load() == handle)
+        obj = entry.obj;
+    entry.readers.fetch_sub(1);
+
+    return obj;
+}
+
+} // namespace RefLib
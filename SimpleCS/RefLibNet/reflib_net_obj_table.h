@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include "reflib_composit_id.h"
+#include "reflib_safelock.h"
+
+namespace RefLib
+{
+
+class NetObj;
+
+// NetObjs by connection slot. An object is attached to its slot while it
+// waits for a connection and published under the connection's full
+// CompositId while connected; lookups only match the published id, so a
+// handle from an earlier connection on the same slot finds nothing.
+class NetObjTable
+{
+public:
+    NetObjTable();
+    ~NetObjTable();
+
+    bool Initialize(uint32 capacity);
+
+    bool Attach(uint32 slot, std::shared_ptr<NetObj> obj);
+    // undo an Attach whose connection never started; no-op once the slot moved on
+    void Detach(uint32 slot, const std::shared_ptr<NetObj>& obj);
+    bool Publish(const CompositId& id);
+    // keep leaves the object attached for the slot's next connection
+    bool Retire(const CompositId& id, bool keep);
+
+    // Lock free: the object is copied only while the entry's handle matches id,
+    // and writers wait for such readers before they change the object.
+    std::shared_ptr<NetObj> Find(const CompositId& id) const;
+
+private:
+    struct Entry
+    {
+        Entry() : handle(NET_OBJ_NO_HANDLE), readers(0) {}
+
+        std::shared_ptr<NetObj> obj;    // written under _writeLock once readers drain
+        std::atomic<uint64> handle;     // CompositId index while published
+        mutable std::atomic<uint32> readers;   // Finds between handle check and copy
+    };
+
+    // Readers that saw the old handle may still be copying obj; anyone later
+    // sees the new handle first and leaves obj alone.
+    static void WaitReaders(const Entry& entry);
+
+    std::unique_ptr<Entry[]> _entries;
+    uint32 _capacity;
+
+    // attach, publish and retire are per connection, not per lookup
+    SafeLock _writeLock;
+};
+
+} // namespace RefLib
@@ -20,6 +20,37 @@ void NetProfiler::ResetProfile()
     _bytesReadLast = 0;
     _bytesSentLast = 0;
     _startTimeLast = 0;
+    _recvWakeups = 0;
+    _recvReads = 0;
+    _recvSyscalls = 0;
+    _rttSamples = 0;
+    _rttSumUsec = 0;
+    _rttMaxUsec = 0;
+
+    for (int i = 0; i < NetCompletionOP::OP_TYPE_CNT; ++i)
+    {
+        _opsPosted[i] = 0;
+        _opsBusy[i] = 0;
+    }
+}
+
+void NetProfiler::OnRecvWakeup(uint32 reads, uint32 syscalls, uint64 bytes)
+{
+    _recvWakeups.fetch_add(1);
+    _recvReads.fetch_add(reads);
+    _recvSyscalls.fetch_add(syscalls);
+    _bytesRead.fetch_add(bytes);
+    _bytesReadLast.fetch_add(bytes);
+}
+
+void NetProfiler::OnRttSample(uint64 rttUsec)
+{
+    _rttSamples.fetch_add(1);
+    _rttSumUsec.fetch_add(rttUsec);
+
+    uint64 maxRtt = _rttMaxUsec.load();
+    while (rttUsec > maxRtt && !_rttMaxUsec.compare_exchange_weak(maxRtt, rttUsec))
+        ;
 }
 
 void NetProfiler::StartProfile()
@@ -42,6 +73,30 @@ void NetProfiler::PrintStatistics()
     bps = _bytesRead / elapsed;
     DebugPrint("Average BPS read: %llu [%llu]", bps, _bytesRead.load());
 
+    uint64 wakeups = _recvWakeups.load();
+    uint64 syscalls = _recvSyscalls.load();
+    if (wakeups > 0 && syscalls > 0)
+    {
+        DebugPrint("Reads per wakeup: %.2f", static_cast<double>(_recvReads.load()) / wakeups);
+        DebugPrint("Bytes per recv call: %llu", _bytesRead.load() / syscalls);
+    }
+
+    DebugPrint("I/O ops posted: connect(%llu) read(%llu) write(%llu) disconnect(%llu)",
+        _opsPosted[NetCompletionOP::OP_CONNECT].load(),
+        _opsPosted[NetCompletionOP::OP_READ].load(),
+        _opsPosted[NetCompletionOP::OP_WRITE].load(),
+        _opsPosted[NetCompletionOP::OP_DISCONNECT].load());
+    DebugPrint("I/O ops busy: write(%llu) disconnect(%llu)",
+        _opsBusy[NetCompletionOP::OP_WRITE].load(),
+        _opsBusy[NetCompletionOP::OP_DISCONNECT].load());
+
+    uint64 rttSamples = _rttSamples.load();
+    if (rttSamples > 0)
+    {
+        DebugPrint("Heartbeat RTT: samples(%llu) avg(%llu usec) max(%llu usec)",
+            rttSamples, _rttSumUsec.load() / rttSamples, _rttMaxUsec.load());
+    }
+
     elapsed = (tick > _startTimeLast) ? (tick - _startTimeLast) / 1000 : 0;
     if (elapsed == 0)
         return;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "reflib_type_def.h"
+#include "reflib_net_completion.h"
 #include <atomic>
 
 namespace RefLib
@@ -11,10 +12,22 @@ class NetProfiler
 public:
     NetProfiler();
 
+    void PrintStatistics();
+
+    // called once per recv completion with the totals of its drain loop
+    void OnRecvWakeup(uint32 reads, uint32 syscalls, uint64 bytes);
+
+    // I/O ops are embedded per socket; these count how often they are reused
+    // and how often a send found its op still in flight.
+    void OnOpPosted(NetCompletionOP::NetOPType op) { _opsPosted[op].fetch_add(1); }
+    void OnOpBusy(NetCompletionOP::NetOPType op) { _opsBusy[op].fetch_add(1); }
+
+    // heartbeat round trips across all sockets, in microseconds
+    void OnRttSample(uint64 rttUsec);
+
 protected:
     void ResetProfile();
     void StartProfile();
-    void PrintStatistics();
 
     std::atomic<uint64> _bytesRead;
     std::atomic<uint64> _bytesSent;
@@ -22,6 +35,17 @@ protected:
     std::atomic<uint64> _bytesReadLast;
     std::atomic<uint64> _bytesSentLast;
     std::atomic<uint64> _startTimeLast;
+
+    std::atomic<uint64> _recvWakeups;
+    std::atomic<uint64> _recvReads;
+    std::atomic<uint64> _recvSyscalls;
+
+    std::atomic<uint64> _opsPosted[NetCompletionOP::OP_TYPE_CNT];
+    std::atomic<uint64> _opsBusy[NetCompletionOP::OP_TYPE_CNT];
+
+    std::atomic<uint64> _rttSamples;
+    std::atomic<uint64> _rttSumUsec;
+    std::atomic<uint64> _rttMaxUsec;
 };
 
 } // namespace RefLib
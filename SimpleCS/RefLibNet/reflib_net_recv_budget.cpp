@@ -0,0 +1,102 @@
+#include "stdafx.h"
+
+#include "reflib_net_recv_budget.h"
+#include "reflib_net_socket.h"
+
+namespace RefLib
+{
+
+RecvMemoryBudget::RecvMemoryBudget()
+    : _total(0)
+    , _limit(0)
+    , _resumeLevel(0)
+    , _connections(0)
+    , _shedCount(0)
+{
+    for (auto& accounted : _accounted)
+        accounted = 0;
+}
+
+void RecvMemoryBudget::SetLimit(uint64 limit)
+{
+    _limit = limit;
+    _resumeLevel = limit / 100 * NETWORK_RECV_BUDGET_RESUME_PERCENT;
+}
+
+void RecvMemoryBudget::Charge(RecvMemCategory category, uint64 bytes)
+{
+    _accounted[category].fetch_add(bytes);
+    _total.fetch_add(bytes);
+}
+
+void RecvMemoryBudget::Release(RecvMemCategory category, uint64 bytes)
+{
+    _accounted[category].fetch_sub(bytes);
+    uint64 total = _total.fetch_sub(bytes) - bytes;
+
+    if (_shedCount.load() > 0 && total <= _resumeLevel)
+        ResumeShed();
+}
+
+bool RecvMemoryBudget::IsOverBudget() const
+{
+    uint64 limit = _limit.load();
+    return (limit > 0 && _total.load() > limit);
+}
+
+uint64 RecvMemoryBudget::GetFairShare() const
+{
+    uint32 connections = _connections.load();
+    return (connections > 0) ? _total.load() / connections : _total.load();
+}
+
+void RecvMemoryBudget::Shed(NetSocket* sock)
+{
+    SafeLock::Owner lock(_shedLock);
+
+    if (_shed.insert(sock).second)
+        _shedCount.fetch_add(1);
+}
+
+void RecvMemoryBudget::Forget(NetSocket* sock)
+{
+    SafeLock::Owner lock(_shedLock);
+
+    if (_shed.erase(sock) > 0)
+        _shedCount.fetch_sub(1);
+}
+
+// This can run on a logic thread through PopRecvPacket, so the resumes are
+// posted to the sockets' I/O threads. Each socket is pinned by an I/O
+// reference taken under the lock, before Forget could let it go.
+// A socket that is still over its share sheds itself again on the next read.
+void RecvMemoryBudget::ResumeShed()
+{
+    std::set<NetSocket*> shed;
+    {
+        SafeLock::Owner lock(_shedLock);
+
+        std::swap(shed, _shed);
+        _shedCount = 0;
+
+        for (auto sock : shed)
+            sock->AddIoRef();
+    }
+
+    for (auto sock : shed)
+    {
+        sock->PostResumeRecv();
+    }
+}
+
+void RecvMemoryBudget::PrintStatistics() const
+{
+    DebugPrint("Recv memory: %llu / %llu bytes, ring(%llu) posted(%llu) packet(%llu), shed sockets(%d)",
+        _total.load(), _limit.load(),
+        _accounted[RECV_MEM_RING].load(),
+        _accounted[RECV_MEM_POSTED].load(),
+        _accounted[RECV_MEM_PACKET].load(),
+        _shedCount.load());
+}
+
+} // namespace RefLib
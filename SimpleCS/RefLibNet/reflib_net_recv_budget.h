@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <set>
+#include "reflib_type_def.h"
+#include "reflib_non_copyable.h"
+#include "reflib_safelock.h"
+
+namespace RefLib
+{
+
+class NetSocket;
+
+enum RecvMemCategory
+{
+    RECV_MEM_RING,      // CircularBuffer capacity of connected sockets
+    RECV_MEM_POSTED,    // buffers of outstanding WSARecv calls
+    RECV_MEM_PACKET,    // packets queued on NetObj, not yet popped by the logic thread
+    RECV_MEM_CATEGORY_CNT,
+};
+
+// Accounts inbound memory of one NetService and sheds reads when it runs over.
+class RecvMemoryBudget : public NonCopyable
+{
+public:
+    RecvMemoryBudget();
+
+    // 0 disables the budget
+    void SetLimit(uint64 limit);
+    uint64 GetLimit() const { return _limit; }
+
+    void Charge(RecvMemCategory category, uint64 bytes);
+    void Release(RecvMemCategory category, uint64 bytes);
+
+    void AddConnection() { _connections.fetch_add(1); }
+    void RemoveConnection() { _connections.fetch_sub(1); }
+
+    bool IsOverBudget() const;
+    uint64 GetFairShare() const;
+
+    // Register a socket that paused its reads; it is resumed once usage drains
+    // below the resume level.
+    void Shed(NetSocket* sock);
+    void Forget(NetSocket* sock);
+
+    uint64 GetAccounted(RecvMemCategory category) const { return _accounted[category]; }
+    uint64 GetTotal() const { return _total; }
+    uint32 GetShedCount() const { return _shedCount; }
+
+    void PrintStatistics() const;
+
+private:
+    void ResumeShed();
+
+    std::atomic<uint64> _accounted[RECV_MEM_CATEGORY_CNT];
+    std::atomic<uint64> _total;
+    std::atomic<uint64> _limit;
+    std::atomic<uint64> _resumeLevel;
+    std::atomic<uint32> _connections;
+
+    std::atomic<uint32> _shedCount;
+    std::set<NetSocket*> _shed;
+    SafeLock _shedLock;
+};
+
+} // namespace RefLib
@@ -10,6 +10,9 @@
 #include "reflib_net_obj.h"
 #include "reflib_def.h"
 #include "reflib_net_api.h"
+#include "reflib_page_arena.h"
+#include "reflib_memory_pool.h"
+#include "reflib_tick_arena.h"
 
 namespace RefLib
 {
@@ -19,7 +22,10 @@ namespace RefLib
 
 NetService::NetService()
     : _maxCnt(0)
+    , _conCacheSize(NETWORK_CONN_FREE_CACHE)
     , _comPort(INVALID_HANDLE_VALUE)
+    , _recvMode(NET_RECV_MODE_OVERLAPPED)
+    , _numaPinning(false)
 {
 }
 
@@ -51,13 +57,23 @@ bool NetService::InitServer(uint32 maxCnt, uint32 concurrency)
     }
 
     _maxCnt = maxCnt;
-    _objs.resize(maxCnt);
+    if (!_objTable.Initialize(maxCnt))
+        return false;
+
+    if (!_affinity.Initialize(_affinityPolicy))
+        return false;
 
     _netConnectionProxy = std::make_unique<NetListener>(this);
     if (!_netConnectionProxy->Initialize(maxCnt, concurrency))
         return false;
 
-    return CreateThreads(concurrency);
+    if (!CreateThreads(concurrency))
+        return false;
+
+    if (_numaPinning)
+        PinToNumaNodes();
+
+    return true;
 }
 
 bool NetService::InitClient(uint32 maxCnt, uint32 concurrency)
@@ -79,7 +95,11 @@ bool NetService::InitClient(uint32 maxCnt, uint32 concurrency)
     }
 
     _maxCnt = maxCnt;
-    _objs.resize(maxCnt);
+    if (!_objTable.Initialize(maxCnt))
+        return false;
+
+    if (!_affinity.Initialize(_affinityPolicy))
+        return false;
 
     _netConnectionProxy = std::make_unique<NetConnector>(this);
     if (!_netConnectionProxy->Initialize(maxCnt, concurrency))
@@ -88,6 +108,9 @@ bool NetService::InitClient(uint32 maxCnt, uint32 concurrency)
     if (!CreateThreads(concurrency))
         return false;
 
+    if (_numaPinning)
+        PinToNumaNodes();
+
     RunableThreads::Activate();
 
     return true;
@@ -101,7 +124,7 @@ bool NetService::AddListeningObj(std::weak_ptr<NetObj> obj)
         return false;
     }
 
-    return RegisterNetObj(obj);
+    return RegisterNetObj(obj, true);
 }
 
 void NetService::StartListen(unsigned port)
@@ -115,6 +138,19 @@ void NetService::StartListen(unsigned port)
     _netConnectionProxy->Listen(port);
 }
 
+bool NetService::TakeOver(const std::wstring& pipeName, const NetHandoffPolicy& policy, NetHandoffReport& report)
+{
+    if (_netConnectionProxy->GetChildType() != NET_CTYPE_LISTENER)
+    {
+        DebugPrint("NetService is not initialized for Listening.");
+        return false;
+    }
+    RunableThreads::Activate();
+
+    NetHandoff handoff(policy, _netConnectionProxy.get());
+    return handoff.Receive(pipeName, report);
+}
+
 bool NetService::Connect(const std::string& ipStr, uint32 port, std::weak_ptr<NetObj> obj)
 {
     if (_netConnectionProxy->GetChildType() != NET_CTYPE_CONNECTOR)
@@ -123,84 +159,127 @@ bool NetService::Connect(const std::string& ipStr, uint32 port, std::weak_ptr<Ne
         return false;
     }
 
-    if (!RegisterNetObj(obj))
+    if (!RegisterNetObj(obj, false))
         return false;
 
-    return _netConnectionProxy->Connect(ipStr, port, obj);
+    CompositId id = obj.lock()->GetCompId();
+    if (!_netConnectionProxy->Connect(ipStr, port, obj))
+    {
+        DetachNetObj(obj, id);
+        return false;
+    }
+
+    return true;
 }
 
-bool NetService::RegisterNetObj(std::weak_ptr<NetObj> obj)
+NetConnectResult NetService::ConnectAsync(const SOCKADDR_IN& addr, std::weak_ptr<NetObj> obj, NetConnectObserver* observer, uint32 tag)
+{
+    if (_netConnectionProxy->GetChildType() != NET_CTYPE_CONNECTOR)
+    {
+        DebugPrint("NetService is not initialized for Connector.");
+        return NET_CONNECT_FAIL_LAUNCH;
+    }
+
+    if (!RegisterNetObj(obj, false))
+        return NET_CONNECT_FAIL_REGISTER;
+
+    CompositId id = obj.lock()->GetCompId();
+    if (!_netConnectionProxy->Connect(addr, obj, observer, tag))
+    {
+        DetachNetObj(obj, id);
+        return NET_CONNECT_FAIL_LAUNCH;
+    }
+
+    return NET_CONNECT_OK;
+}
+
+bool NetService::RegisterNetObj(std::weak_ptr<NetObj> obj, bool pinned)
 {
     auto p = obj.lock();
     if (!p) return false;
 
-    auto con = _netConnectionProxy->RegisterCon().lock();
+    auto con = _netConnectionProxy->RegisterCon(pinned).lock();
     if (!con) return false;
 
     if (p->Initialize(con))
     {
-        con->RegisterParent(p);
+        con->RegisterParent(p, pinned);
 
-        SafeLock::Owner lock(_freeLock);
-
-        uint32 slot = static_cast<uint32>(_freeObjs.size());
-        _freeObjs.emplace(slot, p);
-
-        return true;
+        if (_objTable.Attach(con->GetCompId().GetSlotId(), p))
+            return true;
     }
 
+    // a pinned slot is already waiting on the accept list
+    if (!pinned)
+        _netConnectionProxy->UnregisterCon(con->GetCompId());
+
     return false;
 }
 
-std::weak_ptr<NetObj> NetService::GetNetObj(const CompositId& id)
+// The slot may already be registered again by now; Detach only drops obj itself.
+void NetService::DetachNetObj(std::weak_ptr<NetObj> obj, const CompositId& id)
 {
-    if (id.GetSlotId() >= _maxCnt)
-        return std::weak_ptr<NetObj>();
-
-    return _objs[id.GetSlotId()];
+    if (auto p = obj.lock())
+        _objTable.Detach(id.GetSlotId(), p);
 }
 
-bool NetService::AllocNetObj(const CompositId& id)
+bool NetService::AttachNetObj(std::shared_ptr<NetConnection> con)
 {
-    if (id.GetSlotId() >= _maxCnt)
+    if (!_netObjFactory || !con)
         return false;
 
-    SafeLock::Owner lock(_freeLock);
-
-    auto it = _freeObjs.find(id.GetSlotId());
-    if (it == _freeObjs.end())
+    auto p = _netObjFactory();
+    if (!p || !p->Initialize(con))
         return false;
 
-    std::shared_ptr<NetObj> p = it->second;
+    con->RegisterParent(p);
 
-    _freeObjs.erase(it);
-    _objs[id.GetSlotId()] = p;
+    return _objTable.Attach(con->GetCompId().GetSlotId(), p);
+}
 
-    return true;
+std::shared_ptr<NetObj> NetService::GetNetObj(const CompositId& id)
+{
+    return _objTable.Find(id);
 }
 
-bool NetService::FreeNetObj(const CompositId& id)
+bool NetService::AllocNetObj(const CompositId& id)
 {
-    if (id.GetSlotId() >= _maxCnt)
-        return false;
+    return _objTable.Publish(id);
+}
 
-    auto p = _objs[id.GetSlotId()];
+bool NetService::FreeNetObj(const CompositId& id)
+{
+    auto p = _objTable.Find(id);
     if (!p)
         return false;
 
-    _freeObjs.emplace(id.GetSlotId(), p);
-    _objs[id.GetSlotId()].reset();
-
-    return true;
+    // only pinned objects wait for the next connection; the rest die with it
+    auto con = p->GetConn().lock();
+    return _objTable.Retire(id, con && con->IsPinned());
 }
 
 void NetService::Run()
+{
+    DispatchPackets(_comPort);
+}
+
+unsigned NetService::RunByThread()
+{
+    unsigned rc = RunableThreads::RunByThread();
+
+    // while this thread's pool cache is still alive
+    TickArena::Current().Release();
+
+    return rc;
+}
+
+void NetService::DispatchPackets(HANDLE comPort)
 {
     ULONG_PTR ulKey;
     OVERLAPPED *lpOverlapped;
     DWORD bytesTransfered;
 
-    int rc = GetQueuedCompletionStatus(_comPort, &bytesTransfered,
+    int rc = GetQueuedCompletionStatus(comPort, &bytesTransfered,
         &ulKey, &lpOverlapped, THREAD_TIMEOUT_IN_MSEC);
 
     // Check time out
@@ -210,7 +289,53 @@ void NetService::Run()
     if (NetObj* obj = (NetObj*)ulKey)
     {
         obj->OnRecvPacket();
+        // may drop the last reference to obj
+        obj->ReleasePost();
     }
+
+    // everything the handler took from the tick arena dies here
+    TickArena::Current().Reset();
+}
+
+bool NetService::Warmup(const NetWarmupConfig& config, NetWarmupReport& report)
+{
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(_netConnectionProxy, "NetService is not initialized", false);
+
+    if (config.connections > 0)
+        _netConnectionProxy->Materialize(config.connections);
+
+    std::vector<std::shared_ptr<NetConnection>> cons;
+    _netConnectionProxy->GetConnections(cons);
+
+    NetWarmup warmup(config, std::move(cons));
+    return warmup.Run(report);
+}
+
+bool NetService::Drain(const NetDrainPolicy& policy, NetDrainReport& report)
+{
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(_netConnectionProxy, "NetService is not initialized", false);
+
+    NetDrainer drainer(policy, _netConnectionProxy.get());
+    return drainer.Run(report);
+}
+
+bool NetService::HandOff(const std::wstring& pipeName, const NetHandoffPolicy& policy, NetHandoffReport& report)
+{
+    REFLIB_ASSERT_RETURN_VAL_IF_FAILED(_netConnectionProxy, "NetService is not initialized", false);
+
+    NetHandoff handoff(policy, _netConnectionProxy.get());
+    return handoff.Send(pipeName, report);
+}
+
+void NetService::PrintStatistics()
+{
+    if (_netConnectionProxy)
+        _netConnectionProxy->PrintStatistics();
+
+    _affinity.PrintStatistics();
+    _recvBudget.PrintStatistics();
+    g_pageArena.PrintStatistics();
+    g_memoryPool.Dump();
 }
 
 void NetService::Shutdown()
@@ -224,6 +349,9 @@ void NetService::Shutdown()
     }
 
     Join();
+
+    // connections are closed by now, so nothing is left queued to the shards
+    _affinity.Shutdown();
 }
 
 void NetService::OnTerminated()
@@ -249,6 +377,11 @@ void NetServerService::StartListen(unsigned port)
 	return NetService::StartListen(port);
 }
 
+bool NetServerService::TakeOver(const std::wstring& pipeName, const NetHandoffPolicy& policy, NetHandoffReport& report)
+{
+	return NetService::TakeOver(pipeName, policy, report);
+}
+
 ///////////////////////////////////////////////////////////////////
 // NetClientService
 
@@ -262,4 +395,27 @@ bool NetClientService::Connect(const std::string& ipStr, uint32 port, std::weak_
 	return NetService::Connect(ipStr, port, obj);
 };
 
+NetConnectResult NetClientService::ConnectAsync(const SOCKADDR_IN& addr, std::weak_ptr<NetObj> obj, NetConnectObserver* observer, uint32 tag)
+{
+	return NetService::ConnectAsync(addr, obj, observer, tag);
+}
+
+std::shared_ptr<NetBulkConnect> NetClientService::ConnectMany(const std::string& ipStr, uint32 port, uint32 count,
+	NetBulkObjFactory factory, const NetBulkConnectPolicy& policy, const NetBulkConnectCallbacks& callbacks)
+{
+	SOCKADDR_IN addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, ipStr.c_str(), &addr.sin_addr) != 1)
+	{
+		DebugPrint("ConnectMany: invalid ip address(%s)", ipStr.c_str());
+		return nullptr;
+	}
+
+	auto bulk = std::make_shared<NetBulkConnect>(this, addr, count, factory, policy, callbacks);
+	bulk->Start();
+	return bulk;
+}
+
 } //namespace RefLib
\ No newline at end of file
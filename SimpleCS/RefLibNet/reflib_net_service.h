@@ -2,17 +2,29 @@
 
 #include <memory>
 #include <vector>
-#include <map>
+#include <functional>
 #include "reflib_runable_threads.h"
-#include "reflib_safelock.h"
 #include "reflib_composit_id.h"
+#include "reflib_net_flood_guard.h"
+#include "reflib_net_timer_wheel.h"
+#include "reflib_net_admission.h"
+#include "reflib_net_drain.h"
+#include "reflib_net_handoff.h"
+#include "reflib_net_bulk_connect.h"
+#include "reflib_net_affinity.h"
+#include "reflib_net_recv_budget.h"
+#include "reflib_net_warmup.h"
+#include "reflib_net_obj_table.h"
 
 namespace RefLib
 {
 
 class NetObj;
+class NetConnection;
 class NetConnectionProxy;
 
+typedef std::function<std::shared_ptr<NetObj>()> NetObjFactory;
+
 ///////////////////////////////////////////////////////////////////
 // NetServicec
 class NetService
@@ -25,7 +37,65 @@ public:
     void Shutdown();
 
     HANDLE GetCompletionPort() const { return _comPort; }
-    std::weak_ptr<NetObj> GetNetObj(const CompositId& id);
+
+    // applies to connections initialized afterwards
+    void SetRecvMode(NetRecvMode mode) { _recvMode = mode; }
+    NetRecvMode GetRecvMode() const { return _recvMode; }
+
+    // per-connection inbound rate limits, applied when a connection is established
+    void SetFloodPolicy(const NetFloodPolicy& policy) { _floodPolicy = policy; }
+    const NetFloodPolicy& GetFloodPolicy() const { return _floodPolicy; }
+
+    // handshake, idle and keepalive deadlines, applied when a connection is established
+    void SetTimeoutPolicy(const NetTimeoutPolicy& policy) { _timeoutPolicy = policy; }
+    const NetTimeoutPolicy& GetTimeoutPolicy() const { return _timeoutPolicy; }
+
+    // per source address connect rate and concurrency limits; set before StartListen
+    void SetAdmissionPolicy(const NetAdmissionPolicy& policy) { _admissionPolicy = policy; }
+    const NetAdmissionPolicy& GetAdmissionPolicy() const { return _admissionPolicy; }
+
+    // Pin worker and logic threads to NUMA nodes round robin; set before Initialize.
+    // Pool buffers are then allocated from, and returned to, each thread's node.
+    void SetNumaPinning(bool pin) { _numaPinning = pin; }
+    bool IsNumaPinning() const { return _numaPinning; }
+
+    // Shard connections by slot, each shard with its own I/O and logic threads; set before Initialize.
+    void SetAffinityPolicy(const NetAffinityPolicy& policy) { _affinityPolicy = policy; }
+    const NetAffinityPolicy& GetAffinityPolicy() const { return _affinityPolicy; }
+    NetAffinity& GetAffinity() { return _affinity; }
+
+    // Bytes of inbound memory the service may hold before it sheds reads; 0 is unlimited.
+    void SetRecvMemoryLimit(uint64 limit) { _recvBudget.SetLimit(limit); }
+    RecvMemoryBudget& GetRecvMemoryBudget() { return _recvBudget; }
+
+    // Builds a NetObj for each accepted connection that has none registered,
+    // so listeners do not have to be pre-created for peak capacity.
+    void SetNetObjFactory(NetObjFactory factory) { _netObjFactory = factory; }
+    bool AttachNetObj(std::shared_ptr<NetConnection> con);
+
+    // Idle connections kept built for reuse; set before Initialize.
+    void SetConnectionCacheSize(uint32 size) { _conCacheSize = size; }
+    uint32 GetConnectionCacheSize() const { return _conCacheSize; }
+
+    // Opt-in warm start; call after Initialize and before listening or connecting.
+    bool Warmup(const NetWarmupConfig& config, NetWarmupReport& report);
+
+    // Graceful close for a rolling restart: stop accepting, let NetObjs
+    // migrate, then close flushed connections in paced batches. Blocks until
+    // every connection is closed or the deadline passes; call Shutdown afterwards.
+    bool Drain(const NetDrainPolicy& policy, NetDrainReport& report);
+
+    // Hot restart, old side: pass the listen socket and, per policy, the live
+    // connections to the process waiting on pipeName, e.g. \\.\pipe\game-7000.
+    // Whatever could not be handed over stays here; call Shutdown afterwards.
+    bool HandOff(const std::wstring& pipeName, const NetHandoffPolicy& policy, NetHandoffReport& report);
+
+    void PrintStatistics();
+    // Null unless id names the object's current connection. Lock free.
+    std::shared_ptr<NetObj> GetNetObj(const CompositId& id);
+
+    // one wait on a logic completion port, run by the service's and the shards' logic threads
+    static void DispatchPackets(HANDLE comPort);
 
     bool AllocNetObj(const CompositId& id);
     bool FreeNetObj(const CompositId& id);
@@ -37,29 +107,41 @@ protected:
 	bool InitServer(uint32 maxCnt, uint32 concurrency);
 	virtual bool AddListeningObj(std::weak_ptr<NetObj> obj);
 	virtual void StartListen(unsigned port);
+	// Instead of StartListen: waits on pipeName for the previous process's HandOff.
+	// Set the NetObj factory first; adopted connections get their NetObjs from it.
+	virtual bool TakeOver(const std::wstring& pipeName, const NetHandoffPolicy& policy, NetHandoffReport& report);
 
 	// Client only
 	bool InitClient(uint32 maxCnt, uint32 concurrency);
 	virtual bool Connect(const std::string& ipStr, uint32 port, std::weak_ptr<NetObj> obj);
+	// observer hears the outcome with tag unless the launch itself fails
+	NetConnectResult ConnectAsync(const SOCKADDR_IN& addr, std::weak_ptr<NetObj> obj, NetConnectObserver* observer, uint32 tag);
 
-	bool RegisterNetObj(std::weak_ptr<NetObj> obj);
+	bool RegisterNetObj(std::weak_ptr<NetObj> obj, bool pinned);
+	// the connector has given the slot back; drop the table's hold on obj
+	void DetachNetObj(std::weak_ptr<NetObj> obj, const CompositId& id);
 
     // run by thread
     virtual void Run() override;
+    virtual unsigned RunByThread() override;
 
 private:
-    typedef std::map<uint32, std::shared_ptr<NetObj>> FREE_NET_OBJS;
-    typedef std::vector<std::shared_ptr<NetObj>> GAME_NET_OBJS;
-
-    GAME_NET_OBJS _objs;
-    FREE_NET_OBJS _freeObjs;
+    NetObjTable _objTable;
 
     std::unique_ptr<NetConnectionProxy> _netConnectionProxy;
+    NetObjFactory _netObjFactory;
 
     uint32 _maxCnt;
+    uint32 _conCacheSize;
     HANDLE _comPort;
-
-    SafeLock _freeLock;
+    NetRecvMode _recvMode;
+    bool _numaPinning;
+    NetFloodPolicy _floodPolicy;
+    NetTimeoutPolicy _timeoutPolicy;
+    NetAdmissionPolicy _admissionPolicy;
+    RecvMemoryBudget _recvBudget;
+    NetAffinityPolicy _affinityPolicy;
+    NetAffinity _affinity;
 };
 
 ///////////////////////////////////////////////////////////////////
@@ -70,6 +152,7 @@ public:
 	bool Initialize(uint32 maxCnt, uint32 concurrency);
 	virtual bool AddListeningObj(std::weak_ptr<NetObj> obj) override;
 	virtual void StartListen(unsigned port) override;
+	virtual bool TakeOver(const std::wstring& pipeName, const NetHandoffPolicy& policy, NetHandoffReport& report) override;
 };
 
 ///////////////////////////////////////////////////////////////////
@@ -79,6 +162,10 @@ class NetClientService : public NetService
 public:
 	bool Initialize(uint32 maxCnt, uint32 concurrency);
 	virtual bool Connect(const std::string& ipStr, uint32 port, std::weak_ptr<NetObj> obj) override;
+	NetConnectResult ConnectAsync(const SOCKADDR_IN& addr, std::weak_ptr<NetObj> obj, NetConnectObserver* observer, uint32 tag);
+	// Already started. Null if ipStr is not a valid address.
+	std::shared_ptr<NetBulkConnect> ConnectMany(const std::string& ipStr, uint32 port, uint32 count,
+		NetBulkObjFactory factory, const NetBulkConnectPolicy& policy, const NetBulkConnectCallbacks& callbacks);
 };
 
 } // namespace RefLib
\ No newline at end of file
@@ -2,18 +2,47 @@
 
 #include <list>
 #include "reflib_net_socket.h"
-#include "reflib_netio_buffer.h"
 #include "reflib_net_listener.h"
 #include "reflib_memory_pool.h"
 #include "reflib_packet_header_obj.h"
+#include "reflib_frame_scanner.h"
+#include "reflib_net_profiler.h"
+#include "reflib_net_recv_budget.h"
 
 namespace RefLib
 {
 
 NetSocket::NetSocket()
+    : _recvOP(NetCompletionOP::OP_READ)
+    , _sendOP(NetCompletionOP::OP_WRITE)
+    , _resumeOP(NetCompletionOP::OP_RESUME)
+    , _resumeQueued(false)
+    , _comPort(nullptr)
+    , _recvMode(NET_RECV_MODE_OVERLAPPED)
+    , _resumeTimer(nullptr)
+    , _resumeArmed(false)
+    , _recvBudget(nullptr)
+    , _ringBytes(0)
+    , _postedBytes(0)
+    , _timerWheel(nullptr)
+    , _connectedTick(0)
+    , _lastRecvTick(0)
+    , _lastPingTick(0)
 {
 }
 
+NetSocket::~NetSocket()
+{
+    CancelTimer();
+    CancelResumeTimer(true);
+    ReleaseRecvMemory();
+}
+
+void NetSocket::SetFloodPolicy(const NetFloodPolicy& policy)
+{
+    _floodPolicy = policy;
+}
+
 bool NetSocket::Initialize(SOCKET sock) 
 { 
     REFLIB_ASSERT_RETURN_VAL_IF_FAILED(sock != INVALID_SOCKET, "Socket is invalid", false);
@@ -22,12 +51,72 @@ bool NetSocket::Initialize(SOCKET sock)
     return true;
 }
 
+// Called before the first recv is posted, while nothing else can touch the ring.
 void NetSocket::ClearRecvQueue()
 {
-    SafeLock::Owner guard(_recvLock);
+    OwnerChecker::Scope owner(_recvOwner);
+
+    CancelResumeTimer(true);
+    _netStatus.fetch_and(~NET_STATUS_RECV_PAUSED);
 
-    REFLIB_ASSERT(_recvBuffer.Size() == 0, "Recv buffer is not empty.");
     _recvBuffer.Clear();
+    _floodGuard.Reset(_floodPolicy, GetTickCount64());
+
+    AccountRecvRing();
+}
+
+// Charge ring growth to the budget. The ring is accounted from connect to disconnect.
+void NetSocket::AccountRecvRing()
+{
+    if (!_recvBudget)
+        return;
+
+    uint64 capacity = _recvBuffer.GetCapacity();
+    uint64 prev = _ringBytes.exchange(capacity);
+
+    if (prev == 0)
+        _recvBudget->AddConnection();
+
+    if (capacity > prev)
+        _recvBudget->Charge(RECV_MEM_RING, capacity - prev);
+    else if (capacity < prev)
+        _recvBudget->Release(RECV_MEM_RING, prev - capacity);
+}
+
+void NetSocket::ReleasePostedRecv()
+{
+    uint64 bytes = _postedBytes.exchange(0);
+    if (bytes > 0 && _recvBudget)
+        _recvBudget->Release(RECV_MEM_POSTED, bytes);
+}
+
+void NetSocket::ReleaseRecvMemory()
+{
+    if (!_recvBudget)
+        return;
+
+    _recvBudget->Forget(this);
+    ReleasePostedRecv();
+
+    uint64 bytes = _ringBytes.exchange(0);
+    if (bytes > 0)
+    {
+        _recvBudget->Release(RECV_MEM_RING, bytes);
+        _recvBudget->RemoveConnection();
+    }
+}
+
+uint64 NetSocket::GetRecvMemoryUsage() const
+{
+    return _ringBytes.load() + _postedBytes.load() + GetQueuedRecvBytes();
+}
+
+bool NetSocket::ShouldShedRecv() const
+{
+    if (!_recvBudget || !_recvBudget->IsOverBudget())
+        return false;
+
+    return GetRecvMemoryUsage() > _recvBudget->GetFairShare();
 }
 
 void NetSocket::ClearSendQueue()
@@ -51,15 +140,25 @@ bool NetSocket::PostRecv()
 {
     _netStatus.fetch_or(NET_STATUS_RECV_PENDING);
 
-    NetIoBuffer* recvOP = new NetIoBuffer(NetCompletionOP::OP_READ);
-    recvOP->Reset(GetSocket());
+    _recvOP.Reset(GetSocket());
+
+    MemoryBlock* buffer = _recvOP.Alloc(MAX_PACKET_SIZE);
 
-    MemoryBlock* buffer = recvOP->Alloc(MAX_PACKET_SIZE);
+    if (_profiler)
+        _profiler->OnOpPosted(NetCompletionOP::OP_READ);
+
+    if (_recvBudget)
+    {
+        _postedBytes.fetch_add(buffer->GetDataLen());
+        _recvBudget->Charge(RECV_MEM_POSTED, buffer->GetDataLen());
+    }
 
     WSABUF wbuf;
     wbuf.buf = buffer->GetData();
     wbuf.len = buffer->GetDataLen();
 
+    AddIoRef();
+
     DWORD flags = 0;
     int rc = WSARecv(
         GetSocket(),
@@ -67,7 +166,7 @@ bool NetSocket::PostRecv()
         1,
         NULL,
         &flags,
-        &(recvOP->ol),
+        &(_recvOP.ol),
         NULL
     );
 
@@ -76,11 +175,15 @@ bool NetSocket::PostRecv()
         int error = WSAGetLastError();
         if (error != WSA_IO_PENDING)
         {
-            delete recvOP;
+            _recvOP.ReleaseData();
+            ReleasePostedRecv();
 
             DebugPrint("PostRecv: WSARecv* failed: %s", SocketGetErrorString(error).c_str());
             Disconnect(NET_CTYPE_SYSTEM);
 
+            if (ReleaseIoRef())
+                OnIoReleased();
+
             return false;
         }
     }
@@ -89,18 +192,93 @@ bool NetSocket::PostRecv()
 }
 
 void NetSocket::Send(char* data, uint16 dataLen)
+{
+    Send(MakePacket(data, dataLen));
+}
+
+void NetSocket::Send(MemoryBlockPtr packet)
+{
+    REFLIB_ASSERT_RETURN_IF_FAILED(packet, "Packet is null");
+
+    // the queued sends are already on their way to the next process
+    if (_netStatus.load() & NET_STATUS_HANDOFF_SEALED)
+    {
+        DebugPrint("Send: refused during handoff, socket(%d)", GetSocket());
+        return;
+    }
+
+    // the send queues release their reference with FreeBuffer
+    _sendPendingQueue.push(packet.Detach());
+
+    PrepareSend();
+}
+
+MemoryBlockPtr NetSocket::MakePacket(const char* data, uint16 dataLen)
 {
     PacketHeaderObj packet;
     packet.SetHeader(dataLen);
 
-    MemoryBlock* buffer = g_memoryPool.GetBuffer(dataLen + PACKET_HEADER_SIZE);
+    MemoryBlock* buffer = g_memoryPool.GetBuffer(dataLen + PACKET_HEADER_SIZE, MEMORY_TAG_SEND);
 
     memcpy(buffer->GetData(), packet.header.blob, PACKET_HEADER_SIZE);
     memcpy(buffer->GetData() + PACKET_HEADER_SIZE, data, dataLen);
 
-    _sendPendingQueue.push(buffer);
+    return MemoryBlockPtr(buffer);
+}
 
-    PrepareSend();
+void NetSocket::SendControl(NetControlType type, uint64 timestamp)
+{
+    NetControlFrame frame;
+    frame.type = static_cast<uint16>(type);
+    frame.reserved = 0;
+    frame.timestamp = timestamp;
+
+    PacketHeaderObj packet;
+    packet.SetHeader(sizeof(frame), PACKET_CONTROL_TAG);
+
+    MemoryBlock* buffer = g_memoryPool.GetBuffer(sizeof(frame) + PACKET_HEADER_SIZE, MEMORY_TAG_SEND);
+
+    memcpy(buffer->GetData(), packet.header.blob, PACKET_HEADER_SIZE);
+    memcpy(buffer->GetData() + PACKET_HEADER_SIZE, &frame, sizeof(frame));
+
+    Send(MemoryBlockPtr(buffer));
+}
+
+// Pings are answered from the receive path, so the logic thread never skews the sample.
+NetSocket::ePACKET_EXTRACT_RESULT NetSocket::OnControlFrame(const char* content, uint16 contentLen)
+{
+    if (contentLen != sizeof(NetControlFrame))
+    {
+        DebugPrint("Invalid control frame length(%d)", contentLen);
+        return PER_ERROR;
+    }
+
+    NetControlFrame frame;
+    memcpy(&frame, content, sizeof(frame));
+
+    switch (frame.type)
+    {
+    case NET_CONTROL_PING:
+        SendControl(NET_CONTROL_PONG, frame.timestamp);
+        break;
+    case NET_CONTROL_PONG:
+    {
+        uint64 now = RttEstimator::GetMicroTick();
+        if (frame.timestamp > now)
+            break;
+
+        uint64 rtt = now - frame.timestamp;
+        _rtt.AddSample(rtt);
+        if (_profiler)
+            _profiler->OnRttSample(rtt);
+        break;
+    }
+    default:
+        DebugPrint("Unknown control frame(%d)", frame.type);
+        return PER_ERROR;
+    }
+
+    return PER_SUCCESS;
 }
 
 void NetSocket::PrepareSend()
@@ -108,6 +286,10 @@ void NetSocket::PrepareSend()
     unsigned int sendPacketSize = 0;
     MemoryBlock* buffer = nullptr;
 
+    // the send queue belongs to the handoff until it ends or is cancelled
+    if (_netStatus.load() & NET_STATUS_HANDOFF)
+        return;
+
     while (!_sendPendingQueue.empty()
         && (_sendQueue.unsafe_size() < MAX_SEND_ARRAY_SIZE)
         && (sendPacketSize < DEF_SOCKET_BUFFER_SIZE))
@@ -118,52 +300,61 @@ void NetSocket::PrepareSend()
         sendPacketSize += buffer->GetDataLen();
     }
 
-    if (sendPacketSize > 0)
+    // A send still in flight picks up whatever is queued when it completes.
+    if (!_sendQueue.empty())
         PostSend();
 }
 
+// NET_STATUS_SEND_PENDING guards the embedded send op, as RECV_PENDING does for reads.
 bool NetSocket::PostSend()
 {
     int status = _netStatus.load();
-    int expected = status | NET_STATUS_CONNECTED & NET_STATUS_RECV_PENDING & (!NET_STATUS_SEND_PENDING);
-    int desired = expected | NET_STATUS_SEND_PENDING;
 
-    if (!_netStatus.compare_exchange_strong(expected, desired))
+    do
     {
-        DebugPrint("PostSend: netStatus exchange failed: current(0x%x)", status);
-        return false;
-    }
+        if (!(status & NET_STATUS_CONNECTED) || (status & (NET_STATUS_CLOSE_PENDING | NET_STATUS_HANDOFF)))
+            return false;
 
-    size_t sendQueueSize = _sendQueue.unsafe_size();
-    if (sendQueueSize == 0)
-    {
-        DebugPrint("PostSend: send queue is empty.");
-        return false;
-    }
+        if (status & NET_STATUS_SEND_PENDING)
+        {
+            if (_profiler)
+                _profiler->OnOpBusy(NetCompletionOP::OP_WRITE);
+            return false;
+        }
+    } while (!_netStatus.compare_exchange_weak(status, status | NET_STATUS_SEND_PENDING));
 
-    NetIoBuffer* sendOP = new NetIoBuffer(NetCompletionOP::OP_WRITE);
-    sendOP->Reset(GetSocket());
+    _sendOP.Reset(GetSocket());
 
-    std::vector<WSABUF> wbufs;
-    wbufs.resize(sendQueueSize);
+    WSABUF wbufs[MAX_SEND_ARRAY_SIZE];
+    DWORD bufCnt = 0;
 
     MemoryBlock* buffer = nullptr;
-    int idx = 0;
-    while (_sendQueue.try_pop(buffer))
+    while (bufCnt < MAX_SEND_ARRAY_SIZE && _sendQueue.try_pop(buffer))
     {
-        wbufs[idx].buf = buffer->GetData();
-        wbufs[idx].len = buffer->GetDataLen();
-        sendOP->PushData(buffer);
-        idx++;
+        wbufs[bufCnt].buf = buffer->GetData();
+        wbufs[bufCnt].len = buffer->GetDataLen();
+        _sendOP.PushData(buffer);
+        bufCnt++;
     }
 
+    if (bufCnt == 0)
+    {
+        _netStatus.fetch_and(~NET_STATUS_SEND_PENDING);
+        return false;
+    }
+
+    if (_profiler)
+        _profiler->OnOpPosted(NetCompletionOP::OP_WRITE);
+
+    AddIoRef();
+
     int rc = WSASend(
         GetSocket(),
-        &(wbufs[0]),
-        static_cast<DWORD>(wbufs.size()),
+        wbufs,
+        bufCnt,
         NULL,
         0,
-        &(sendOP->ol),
+        &(_sendOP.ol),
         NULL
     );
 
@@ -172,8 +363,12 @@ bool NetSocket::PostSend()
         if (WSAGetLastError() != WSA_IO_PENDING)
         {
             DebugPrint("PostSend: WSASend* failed: %s", SocketGetLastErrorString().c_str());
+            _sendOP.ReleaseData();
+            _netStatus.fetch_and(~NET_STATUS_SEND_PENDING);
             Disconnect(NET_CTYPE_SYSTEM);
-            delete sendOP;
+
+            if (ReleaseIoRef())
+                OnIoReleased();
 
             return false;
         }
@@ -192,13 +387,18 @@ void NetSocket::OnCompletionFailure(NetCompletionOP* bufObj, DWORD bytesTransfer
     {
     case NetCompletionOP::OP_CONNECT:
     case NetCompletionOP::OP_DISCONNECT:
+    case NetCompletionOP::OP_RESUME:
         break;
     case NetCompletionOP::OP_READ:
+        ReleasePostedRecv();
+        _recvOP.ReleaseData();
+        _netStatus.fetch_and(~NET_STATUS_RECV_PENDING);
+        break;
     case NetCompletionOP::OP_WRITE:
-        delete bufObj;
+        _sendOP.ReleaseData();
+        _netStatus.fetch_and(~NET_STATUS_SEND_PENDING);
         break;
     default:
-        delete bufObj;
         REFLIB_ASSERT(false, "Invalid net op");
         break;
     }
@@ -223,6 +423,10 @@ void NetSocket::OnCompletionSuccess(NetCompletionOP* bufObj, DWORD bytesTransfer
     case NetCompletionOP::OP_DISCONNECT:
         OnDisconnected();
         break;
+    case NetCompletionOP::OP_RESUME:
+        _resumeQueued = false;
+        ResumeRecv();
+        break;
     default:
         REFLIB_ASSERT(false, "Invalid net op");
         break;
@@ -233,37 +437,454 @@ void NetSocket::OnConnected()
 {
     NetSocketBase::OnConnected();
 
+    if (_recvMode == NET_RECV_MODE_DRAIN)
+    {
+        u_long nonBlocking = 1;
+        if (ioctlsocket(GetSocket(), FIONBIO, &nonBlocking) == SOCKET_ERROR)
+        {
+            DebugPrint("OnConnected: ioctlsocket failed, fall back to overlapped recv: %s",
+                SocketGetLastErrorString().c_str());
+            _recvMode = NET_RECV_MODE_OVERLAPPED;
+        }
+    }
+
+    ClearRecvQueue();
+
+    uint64 now = GetTickCount64();
+    _connectedTick = now;
+    _lastRecvTick = 0;
+    _lastPingTick = now;
+    _rtt.Reset();
+
+    uint64 deadline = GetNextDeadline();
+    if (_timerWheel && deadline != 0)
+        _timerWheel->Arm(this, deadline);
+
+    if (!_adoptedSend.empty())
+    {
+        MemoryBlock* buffer = g_memoryPool.GetBuffer(static_cast<unsigned int>(_adoptedSend.size()), MEMORY_TAG_SEND);
+        memcpy(buffer->GetData(), _adoptedSend.data(), _adoptedSend.size());
+        std::vector<char>().swap(_adoptedSend);
+
+        Send(MemoryBlockPtr(buffer));
+    }
+
+    if (!_adoptedData.empty())
+    {
+        std::vector<char> adopted;
+        adopted.swap(_adoptedData);
+        OnRecvData(adopted.data(), static_cast<int>(adopted.size()));
+    }
+
     PostRecv();
 }
 
+bool NetSocket::BeginHandoff()
+{
+    if (!IsConnected())
+        return false;
+
+    // from here sends stay queued and reads are not posted again
+    _netStatus.fetch_or(NET_STATUS_HANDOFF | NET_STATUS_RECV_PAUSED);
+    CancelTimer();
+    CancelResumeTimer(true);
+
+    IsHandoffSettled();
+    return true;
+}
+
+bool NetSocket::IsHandoffSettled()
+{
+    int status = _netStatus.load();
+
+    // a recv that already holds data completes normally and parks
+    if (status & NET_STATUS_RECV_PENDING)
+        CancelIoEx(reinterpret_cast<HANDLE>(GetSocket()), &_recvOP.ol);
+
+    // the send in flight completes and leaves the rest queued
+    if (status & (NET_STATUS_RECV_PENDING | NET_STATUS_SEND_PENDING))
+        return false;
+
+    // packets parsed before the pause are still handled here; their replies
+    // must be queued before CollectHandoff takes the queue
+    return IsDispatchIdle();
+}
+
+bool NetSocket::CollectHandoff(std::vector<char>& unread, std::vector<char>& unsent)
+{
+    if (!IsConnected() || !IsHandoffSettled())
+        return false;
+
+    {
+        OwnerChecker::Scope owner(_recvOwner);
+
+        unread.resize(_recvBuffer.Size());
+        if (!unread.empty())
+            _recvBuffer.PeekData(unread.data(), static_cast<unsigned int>(unread.size()));
+    }
+
+    // Whole frames only: a send that completed short already disconnected the socket.
+    // Send refuses new packets from here; one that raced the seal is dropped with the handle.
+    _netStatus.fetch_or(NET_STATUS_HANDOFF_SEALED);
+
+    MemoryBlock* buffer = nullptr;
+    while (_sendQueue.try_pop(buffer))
+        _handoffSends.push_back(buffer);
+    while (_sendPendingQueue.try_pop(buffer))
+        _handoffSends.push_back(buffer);
+
+    unsent.clear();
+    for (auto block : _handoffSends)
+        unsent.insert(unsent.end(), block->GetData(), block->GetData() + block->GetDataLen());
+
+    return true;
+}
+
+void NetSocket::EndHandoff()
+{
+    for (auto block : _handoffSends)
+        g_memoryPool.FreeBuffer(block);
+    _handoffSends.clear();
+
+    Disconnect(NET_CTYPE_HANDOFF);
+    _netStatus.fetch_and(~(NET_STATUS_HANDOFF | NET_STATUS_HANDOFF_SEALED | NET_STATUS_RECV_PAUSED));
+
+    // no I/O is left to report the close, so tear down here
+    OnDisconnected();
+}
+
+void NetSocket::CancelHandoff()
+{
+    // Nothing else touches the send queue during the handoff, so the taken
+    // sends go back ahead of the ones queued since. A closed socket has
+    // already cleared its queues.
+    bool connected = IsConnected();
+    for (auto block : _handoffSends)
+    {
+        if (connected)
+            _sendQueue.push(block);
+        else
+            g_memoryPool.FreeBuffer(block);
+    }
+    _handoffSends.clear();
+
+    _netStatus.fetch_and(~(NET_STATUS_HANDOFF | NET_STATUS_HANDOFF_SEALED));
+
+    if (!IsConnected())
+        return;
+
+    uint64 deadline = GetNextDeadline();
+    if (_timerWheel && deadline != 0)
+        _timerWheel->Arm(this, deadline);
+
+    PrepareSend();
+
+    // the receive path belongs to the I/O threads; this is the handoff thread
+    AddIoRef();
+    PostResumeRecv();
+}
+
 void NetSocket::OnDisconnected()
 {
+    CancelTimer();
+
     NetSocketBase::OnDisconnected();
 
-    ClearRecvQueue();
+    ReleaseRecvMemory();
     ClearSendQueue();
 }
 
+void NetSocket::CancelTimer()
+{
+    if (_timerWheel)
+        _timerWheel->Cancel(this);
+}
+
+// Activity only moves the tick stamps; the wheel entry catches up when it fires.
+uint64 NetSocket::GetNextDeadline() const
+{
+    uint64 deadline = 0;
+    auto earliest = [&deadline](uint64 due) {
+        if (deadline == 0 || due < deadline)
+            deadline = due;
+    };
+
+    uint64 lastRecv = _lastRecvTick;
+    if (_timeoutPolicy.handshakeMsec > 0 && lastRecv == 0)
+        earliest(_connectedTick + _timeoutPolicy.handshakeMsec);
+    if (_timeoutPolicy.idleMsec > 0)
+        earliest((lastRecv ? lastRecv : _connectedTick) + _timeoutPolicy.idleMsec);
+    if (_timeoutPolicy.keepAliveMsec > 0)
+        earliest(_lastPingTick + _timeoutPolicy.keepAliveMsec);
+
+    return deadline;
+}
+
+uint64 NetSocket::OnTimer(uint64 now)
+{
+    int status = _netStatus.load();
+    if (!(status & NET_STATUS_CONNECTED) || (status & NET_STATUS_CLOSE_PENDING))
+        return 0;
+
+    uint64 lastRecv = _lastRecvTick;
+
+    if (_timeoutPolicy.handshakeMsec > 0 && lastRecv == 0
+        && now >= _connectedTick + _timeoutPolicy.handshakeMsec)
+    {
+        _timerWheel->OnTimeout(NET_TIMEOUT_HANDSHAKE);
+        Disconnect(NET_CTYPE_TIMEOUT);
+        return 0;
+    }
+
+    if (_timeoutPolicy.idleMsec > 0
+        && now >= (lastRecv ? lastRecv : _connectedTick) + _timeoutPolicy.idleMsec)
+    {
+        _timerWheel->OnTimeout(NET_TIMEOUT_IDLE);
+        Disconnect(NET_CTYPE_TIMEOUT);
+        return 0;
+    }
+
+    if (_timeoutPolicy.keepAliveMsec > 0 && now >= _lastPingTick + _timeoutPolicy.keepAliveMsec)
+    {
+        _timerWheel->OnTimeout(NET_TIMEOUT_KEEPALIVE);
+        _lastPingTick = now;
+        SendControl(NET_CONTROL_PING, RttEstimator::GetMicroTick());
+    }
+
+    return GetNextDeadline();
+}
+
 void NetSocket::OnRecv(NetCompletionOP* recvOP, DWORD bytesTransfered)
 {
-    REFLIB_ASSERT_RETURN_IF_FAILED(recvOP, "NetIoBuffer is null");
+    REFLIB_ASSERT_RETURN_IF_FAILED(recvOP == &_recvOP, "Unknown recv op");
 
-    NetIoBuffer *ioBuffer = reinterpret_cast<NetIoBuffer*>(recvOP);
     MemoryBlock* buffer;
+    bool alive = false;
+
+    {
+        OwnerChecker::Scope owner(_recvOwner);
+
+        ReleasePostedRecv();
+
+        if ((buffer = _recvOP.PopData()) && bytesTransfered > 0)
+        {
+            OnRecvData(buffer->GetData(), bytesTransfered);
+
+            if (_recvMode == NET_RECV_MODE_DRAIN)
+            {
+                alive = DrainRecv(buffer, bytesTransfered);
+            }
+            else
+            {
+                if (_profiler)
+                    _profiler->OnRecvWakeup(1, 1, bytesTransfered);
+                alive = true;
+            }
+        }
+        else
+        {
+            Disconnect(NetCloseType::NET_CTYPE_SYSTEM);
+        }
+
+        if (buffer)
+            g_memoryPool.FreeBuffer(buffer);
+    }
 
-    if (buffer = ioBuffer->PopData())
+    if (!alive)
     {
-        OnRecvData(buffer->GetData(), bytesTransfered);
+        _netStatus.fetch_and(~NET_STATUS_RECV_PENDING);
+        return;
     }
-    else
+
+    ContinueRecv();
+}
+
+// NET_STATUS_RECV_PENDING doubles as the ownership token of the receive path:
+// it stays set from PostRecv until the completion either re-posts or parks.
+bool NetSocket::TryAcquireRecv()
+{
+    int status = _netStatus.load();
+
+    do
+    {
+        if (!(status & NET_STATUS_CONNECTED))
+            return false;
+        if (status & (NET_STATUS_RECV_PENDING | NET_STATUS_RECV_PAUSED | NET_STATUS_CLOSE_PENDING | NET_STATUS_HANDOFF))
+            return false;
+    } while (!_netStatus.compare_exchange_weak(status, status | NET_STATUS_RECV_PENDING));
+
+    return true;
+}
+
+// Ownership passes to the next completion as soon as the recv is posted.
+void NetSocket::ContinueRecv()
+{
+    if (ShouldShedRecv())
     {
-        Disconnect(NetCloseType::NET_CTYPE_SYSTEM);
+        PauseRecv();
+        _recvBudget->Shed(this);
     }
 
-    delete ioBuffer;
+    if (_netStatus.load() & NET_STATUS_RECV_PAUSED)
+        ParkRecv();
+    else
+        PostRecv();
+}
+
+void NetSocket::ParkRecv()
+{
     _netStatus.fetch_and(~NET_STATUS_RECV_PENDING);
 
-    PostRecv();
+    // ResumeRecv may have run between the pause check and releasing the token.
+    if (TryAcquireRecv())
+        RestartRecv();
+}
+
+void NetSocket::ResumeRecv()
+{
+    _netStatus.fetch_and(~NET_STATUS_RECV_PAUSED);
+
+    if (TryAcquireRecv())
+        RestartRecv();
+}
+
+void NetSocket::PostResumeRecv()
+{
+    // one queued resume covers any number of requests
+    if (!_resumeQueued.exchange(true))
+    {
+        _resumeOP.Reset(GetSocket());
+
+        if (_comPort && ::PostQueuedCompletionStatus(_comPort, 0,
+            (ULONG_PTR)static_cast<NetSocketBase*>(this), &_resumeOP.ol))
+        {
+            return;
+        }
+
+        DebugPrint("PostResumeRecv: PostQueuedCompletionStatus failed: %d", GetLastError());
+        _resumeQueued = false;
+        ResumeRecv();
+    }
+
+    if (ReleaseIoRef())
+        OnIoReleased();
+}
+
+// Deliver what was left buffered while paused, then start reading again.
+void NetSocket::RestartRecv()
+{
+    ePACKET_EXTRACT_RESULT ret;
+
+    {
+        OwnerChecker::Scope owner(_recvOwner);
+        ret = DispatchPackets();
+    }
+
+    if (ret == PER_ERROR)
+    {
+        _netStatus.fetch_and(~NET_STATUS_RECV_PENDING);
+        Disconnect(NET_CTYPE_SYSTEM);
+        return;
+    }
+
+    ContinueRecv();
+}
+
+void NetSocket::ScheduleResumeRecv(uint32 delayMsec)
+{
+    CancelResumeTimer(false);
+
+    // released by the resume the callback posts, or by CancelResumeTimer
+    AddIoRef();
+    _resumeArmed = true;
+
+    if (!::CreateTimerQueueTimer(&_resumeTimer, nullptr, &NetSocket::OnResumeTimer,
+        this, (delayMsec > 0) ? delayMsec : 1, 0, WT_EXECUTEONLYONCE))
+    {
+        DebugPrint("ScheduleResumeRecv: CreateTimerQueueTimer failed: %d", GetLastError());
+        _resumeTimer = nullptr;
+        _resumeArmed = false;
+        _netStatus.fetch_and(~NET_STATUS_RECV_PAUSED);
+
+        if (ReleaseIoRef())
+            OnIoReleased();
+    }
+}
+
+// Only the receive owner arms or cancels the timer. A callback that already
+// fired has taken the reference and posted its resume.
+void NetSocket::CancelResumeTimer(bool wait)
+{
+    if (_resumeTimer)
+    {
+        ::DeleteTimerQueueTimer(nullptr, _resumeTimer, wait ? INVALID_HANDLE_VALUE : nullptr);
+        _resumeTimer = nullptr;
+    }
+
+    // cancelled before it fired
+    if (_resumeArmed.exchange(false))
+    {
+        if (ReleaseIoRef())
+            OnIoReleased();
+    }
+}
+
+// Runs on a timer queue thread; the resume itself belongs to the I/O threads.
+void CALLBACK NetSocket::OnResumeTimer(PVOID param, BOOLEAN timedOut)
+{
+    NetSocket* sock = static_cast<NetSocket*>(param);
+    if (sock && sock->_resumeArmed.exchange(false))
+        sock->PostResumeRecv();
+}
+
+// Keep reading on the nonblocking socket until it runs dry or the budget is spent,
+// so a busy connection costs one completion per burst instead of one per chunk.
+bool NetSocket::DrainRecv(MemoryBlock* buffer, DWORD bytesTransfered)
+{
+    uint32 reads = 1;
+    uint32 syscalls = 1;
+    uint64 bytes = bytesTransfered;
+    bool alive = true;
+
+    while (reads < NETWORK_RECV_DRAIN_BUDGET && bytes < NETWORK_RECV_DRAIN_BYTES)
+    {
+        if (_netStatus.load() & (NET_STATUS_CLOSE_PENDING | NET_STATUS_RECV_PAUSED))
+            break;
+
+        int rc = recv(GetSocket(), buffer->GetData(), buffer->GetDataLen(), 0);
+        ++syscalls;
+
+        if (rc > 0)
+        {
+            ++reads;
+            bytes += rc;
+            OnRecvData(buffer->GetData(), rc);
+            continue;
+        }
+
+        if (rc == 0)
+        {
+            alive = false;
+        }
+        else
+        {
+            int error = WSAGetLastError();
+            if (error != WSAEWOULDBLOCK)
+            {
+                DebugPrint("DrainRecv: recv failed: %s", SocketGetErrorString(error).c_str());
+                alive = false;
+            }
+        }
+        break;
+    }
+
+    if (_profiler)
+        _profiler->OnRecvWakeup(reads, syscalls, bytes);
+
+    if (!alive)
+        Disconnect(NET_CTYPE_SYSTEM);
+
+    return alive;
 }
 
 void NetSocket::OnRecvData(const char* data, int dataLen)
@@ -271,64 +892,187 @@ void NetSocket::OnRecvData(const char* data, int dataLen)
     REFLIB_ASSERT_RETURN_IF_FAILED(data, "null data received.");
     REFLIB_ASSERT_RETURN_IF_FAILED(dataLen, "null size data received.");
 
+    OwnerChecker::Scope owner(_recvOwner);
+
+    _lastRecvTick = GetTickCount64();
+
+    bool stored = _recvBuffer.PutData(data, dataLen);
+    REFLIB_ASSERT(stored, "Data loss: Not enough space");
+    AccountRecvRing();
+
+    if (DispatchPackets() == PER_ERROR)
+        Disconnect(NET_CTYPE_SYSTEM);
+}
+
+NetSocket::ePACKET_EXTRACT_RESULT NetSocket::DispatchPackets()
+{
+    MemoryBlock* packets[MAX_FRAME_BATCH_COUNT];
+    ePACKET_EXTRACT_RESULT ret = PER_SUCCESS;
+
+    while (ret == PER_SUCCESS)
     {
-        SafeLock::Owner guard(_recvLock);
-        REFLIB_ASSERT(_recvBuffer.PutData(data, dataLen), "Data loss: Not enough space");
+        uint32 packetCnt = 0;
+        ret = ExtractPacketBatch(packets, packetCnt);
+
+        bool delivered = true;
+        for (uint32 i = 0; i < packetCnt; ++i)
+        {
+            if (delivered && RecvPacket(packets[i]))
+                continue;
+
+            delivered = false;
+            g_memoryPool.FreeBuffer(packets[i]);
+        }
+
+        if (!delivered)
+            ret = PER_ERROR;
     }
 
-    MemoryBlock* buffer = nullptr;
-    ePACKET_EXTRACT_RESULT ret = PER_NO_DATA;
+    return ret;
+}
+
+// Copy out every complete frame in the contiguous head of the ring with one scan.
+NetSocket::ePACKET_EXTRACT_RESULT NetSocket::ExtractPacketBatch(MemoryBlock** packets, uint32& packetCnt)
+{
+    packetCnt = 0;
+
+    const char* region = nullptr;
+    uint32 regionLen = _recvBuffer.GetReadableRegion(region);
 
-    while ((ret = ExtractPakcetData(buffer)) == PER_SUCCESS)
+    FrameIndex index;
+    FrameScanner::Scan(region, regionLen, index);
+
+    uint64 now = GetTickCount64();
+    uint32 consumed = 0;
+    ePACKET_EXTRACT_RESULT ret = PER_SUCCESS;
+
+    for (uint32 i = 0; i < index.Count() && ret != PER_PAUSED && ret != PER_ERROR; ++i)
     {
-        if (!RecvPacket(buffer))
+        uint16 contentLen = index.GetContentLen(i);
+
+        ret = AdmitPacket(PACKET_HEADER_SIZE + contentLen, now);
+        if (ret == PER_SUCCESS && index.IsControl(i))
         {
-            ret = PER_ERROR;
-            break;
+            ret = OnControlFrame(region + index.GetOffset(i), contentLen);
+        }
+        else if (ret == PER_SUCCESS)
+        {
+            MemoryBlock* buffer = g_memoryPool.GetBuffer(contentLen, MEMORY_TAG_PACKET);
+            memcpy(buffer->GetData(), region + index.GetOffset(i), contentLen);
+            packets[packetCnt++] = buffer;
         }
-    };
 
-    if (ret == PER_ERROR)
-        Disconnect(NET_CTYPE_SYSTEM);
+        // a paused frame stays in the ring for the next pass
+        if (ret != PER_PAUSED)
+            consumed = index.GetOffset(i) + contentLen;
+    }
+    _recvBuffer.Skip(consumed);
+
+    if (ret == PER_PAUSED || ret == PER_ERROR)
+        return ret;
+
+    if (index.IsCorrupted())
+    {
+        DebugPrint("Invalid packet header");
+        return PER_ERROR;
+    }
+
+    if (index.Count() > 0)
+        return PER_SUCCESS;
+
+    // The next frame is either incomplete or wraps around the end of the ring.
+    MemoryBlock* buffer = nullptr;
+    ret = ExtractPakcetData(buffer);
+    if (ret == PER_SUCCESS && buffer)
+        packets[packetCnt++] = buffer;
+
+    return (ret == PER_DROPPED) ? PER_SUCCESS : ret;
 }
 
 NetSocket::ePACKET_EXTRACT_RESULT NetSocket::ExtractPakcetData(MemoryBlock*& buffer)
 {
     PacketHeaderObj packetObj;
 
-    SafeLock::Owner guard(_recvLock);
+    buffer = nullptr;
 
-    if (!_recvBuffer.GetData(packetObj.header.blob, PACKET_HEADER_SIZE))
+    if (!_recvBuffer.PeekData(packetObj.header.blob, PACKET_HEADER_SIZE))
     {
-        buffer = nullptr;
         return PER_NO_DATA;
     }
 
     if (!packetObj.IsValidEnvTag())
     {
         DebugPrint("Invalid packet envelop tag");
-        buffer = nullptr;
         return PER_ERROR;
     }
 
     if (!packetObj.IsValidContentLength())
     {
         DebugPrint("Invalid packet conetnt length");
-        buffer = nullptr;
         return PER_ERROR;
     }
 
     uint16 contentLen = packetObj.GetContentLen();
+    if (_recvBuffer.Size() < static_cast<unsigned int>(PACKET_HEADER_SIZE + contentLen))
+    {
+        return PER_NO_DATA;
+    }
+
+    ePACKET_EXTRACT_RESULT ret = AdmitPacket(PACKET_HEADER_SIZE + contentLen, GetTickCount64());
+    if (ret == PER_DROPPED)
+    {
+        _recvBuffer.Skip(PACKET_HEADER_SIZE + contentLen);
+        return ret;
+    }
+    if (ret != PER_SUCCESS)
+    {
+        return ret;
+    }
+
+    _recvBuffer.Skip(PACKET_HEADER_SIZE);
+
+    if (packetObj.IsControl())
+    {
+        char content[sizeof(NetControlFrame)];
+        if (contentLen > sizeof(content))
+        {
+            DebugPrint("Invalid control frame length(%d)", contentLen);
+            return PER_ERROR;
+        }
 
-    buffer = g_memoryPool.GetBuffer(contentLen);
+        _recvBuffer.GetData(content, contentLen);
+        return OnControlFrame(content, contentLen);
+    }
+
+    buffer = g_memoryPool.GetBuffer(contentLen, MEMORY_TAG_PACKET);
     _recvBuffer.GetData(buffer->GetData(), contentLen);
 
     return PER_SUCCESS;
 }
 
+// Rate check done before any MemoryBlock is allocated for the frame.
+NetSocket::ePACKET_EXTRACT_RESULT NetSocket::AdmitPacket(uint32 frameLen, uint64 now)
+{
+    if (_floodGuard.Admit(frameLen, now))
+        return PER_SUCCESS;
+
+    switch (_floodGuard.GetAction())
+    {
+    case NET_FLOOD_DROP:
+        return PER_DROPPED;
+    case NET_FLOOD_PAUSE_READ:
+        PauseRecv();
+        ScheduleResumeRecv(_floodGuard.GetRetryDelay());
+        return PER_PAUSED;
+    default:
+        DebugPrint("Inbound flood: socket(%d) exceeded its rate limit", GetSocket());
+        return PER_ERROR;
+    }
+}
+
 void NetSocket::OnSent(NetCompletionOP* sendOP, DWORD bytesTransfered)
 {
-    delete sendOP;
+    _sendOP.ReleaseData();
     _netStatus.fetch_and(~NET_STATUS_SEND_PENDING);
 
     PrepareSend();
@@ -1,24 +1,94 @@
 #pragma once
 
+#include <vector>
 #include <concurrent_queue.h>
 #include "reflib_net_socket_base.h"
+#include "reflib_netio_buffer.h"
 #include "reflib_circular_buffer.h"
-#include "reflib_safelock.h"
+#include "reflib_net_flood_guard.h"
+#include "reflib_net_timer_wheel.h"
+#include "reflib_net_heartbeat.h"
+#include "reflib_owner_checker.h"
+#include "reflib_memory_block_ptr.h"
 
 namespace RefLib
 {
 
 class NetObj;
+class RecvMemoryBudget;
 
-class NetSocket : public NetSocketBase
+class NetSocket : public NetSocketBase, public NetTimerTarget
 {
 public:
     NetSocket();
-    virtual ~NetSocket() {}
+    virtual ~NetSocket();
 
     bool Initialize(SOCKET sock);
 
+    void SetRecvMode(NetRecvMode mode) { _recvMode = mode; }
+    void SetFloodPolicy(const NetFloodPolicy& policy);
+    void SetRecvBudget(RecvMemoryBudget* budget) { _recvBudget = budget; }
+
+    // Deadlines are armed on connect and checked by the wheel's worker threads.
+    void SetTimeoutPolicy(const NetTimeoutPolicy& policy) { _timeoutPolicy = policy; }
+    void SetTimerWheel(NetTimerWheel* wheel) { _timerWheel = wheel; }
+
+    const FloodGuard& GetFloodGuard() const { return _floodGuard; }
+
+    // filled by the heartbeat pings this socket sends
+    const RttEstimator& GetRtt() const { return _rtt; }
+
+    // Stop posting reads; buffered frames stay in the receive ring until ResumeRecv.
+    void PauseRecv() { _netStatus.fetch_or(NET_STATUS_RECV_PAUSED); }
+    void ResumeRecv();
+    // ResumeRecv on an I/O thread of the socket's port. The caller has taken
+    // an I/O reference for it, which the completion releases.
+    void PostResumeRecv();
+
+    // the port the socket is associated with
+    void SetCompletionPort(HANDLE comPort) { _comPort = comPort; }
+
+    // inbound bytes held for this socket: ring, posted recv and queued packets
+    uint64 GetRecvMemoryUsage() const;
+
+    // Warm start only, before the socket is connected.
+    void Prefault() { _recvBuffer.Prefault(); }
+    virtual uint64 GetQueuedRecvBytes() const { return 0; }
+    // no parsed packet is waiting for or inside the logic thread
+    virtual bool IsDispatchIdle() const { return true; }
+
+    // Hot restart. BeginHandoff holds reads and sends and cancels a pending read
+    // without waiting, so many sockets can be quiesced at once; poll
+    // IsHandoffSettled until the in-flight I/O is gone and the logic thread has
+    // handled every parsed packet. CollectHandoff then copies out the bytes left
+    // in the receive ring and takes the queued sends, replies included; sends
+    // after that are refused. EndHandoff closes this handle once duplicated;
+    // CancelHandoff resumes the socket and puts the taken sends back.
+    bool BeginHandoff();
+    bool IsHandoffSettled();
+    bool CollectHandoff(std::vector<char>& unread, std::vector<char>& unsent);
+    void EndHandoff();
+    void CancelHandoff();
+
+    // bytes read by the previous process, delivered ahead of the first recv
+    void SetAdoptedData(std::vector<char>&& data) { _adoptedData = std::move(data); }
+    // framed bytes the previous process had queued, sent ahead of anything new
+    void SetAdoptedSend(std::vector<char>&& data) { _adoptedSend = std::move(data); }
+
+    // nothing queued and no send in flight
+    bool IsSendIdle() const
+    {
+        return _sendQueue.empty() && _sendPendingQueue.empty() && !(_netStatus.load() & NET_STATUS_SEND_PENDING);
+    }
+
     void Send(char* data, uint16 dataLen);
+
+    // Queue a packet that already carries its header. Pass a copy to keep the
+    // packet, e.g. to fan it out to other sockets; move it in otherwise.
+    void Send(MemoryBlockPtr packet);
+
+    // header and content in one pooled block, ready for Send
+    static MemoryBlockPtr MakePacket(const char* data, uint16 dataLen);
     virtual bool RecvPacket(MemoryBlock* packet) { return true; }
 
     virtual void OnCompletionSuccess(NetCompletionOP* bufObj, DWORD bytesTransfered) override;
@@ -27,11 +97,15 @@ public:
     virtual void OnConnected() override;
     virtual void OnDisconnected() override;
 
+    virtual uint64 OnTimer(uint64 now) override;
+
 private:
     enum ePACKET_EXTRACT_RESULT
     {
         PER_SUCCESS,
         PER_NO_DATA,
+        PER_DROPPED,
+        PER_PAUSED,
         PER_ERROR,
     };
     void PrepareSend();
@@ -40,18 +114,73 @@ private:
 
     bool PostRecv();
     void OnRecv(NetCompletionOP* recvOP, DWORD bytesTransfered);
+    bool DrainRecv(MemoryBlock* buffer, DWORD bytesTransfered);
+
+    bool TryAcquireRecv();
+    void ContinueRecv();
+    void ParkRecv();
+    void RestartRecv();
+    void ScheduleResumeRecv(uint32 delayMsec);
+    void CancelResumeTimer(bool wait);
+    static void CALLBACK OnResumeTimer(PVOID param, BOOLEAN timedOut);
+
+    void SendControl(NetControlType type, uint64 timestamp);
+    ePACKET_EXTRACT_RESULT OnControlFrame(const char* content, uint16 contentLen);
+
+    uint64 GetNextDeadline() const;
+    void CancelTimer();
 
     void ClearRecvQueue();
     void ClearSendQueue();
 
+    void AccountRecvRing();
+    void ReleasePostedRecv();
+    void ReleaseRecvMemory();
+    bool ShouldShedRecv() const;
+
     void OnRecvData(const char* data, int dataLen);
+    ePACKET_EXTRACT_RESULT DispatchPackets();
+    ePACKET_EXTRACT_RESULT ExtractPacketBatch(MemoryBlock** packets, uint32& packetCnt);
     ePACKET_EXTRACT_RESULT ExtractPakcetData(MemoryBlock*& buffer);
+    ePACKET_EXTRACT_RESULT AdmitPacket(uint32 frameLen, uint64 now);
 
     Concurrency::concurrent_queue<MemoryBlock*> _sendQueue;
     Concurrency::concurrent_queue<MemoryBlock*> _sendPendingQueue;
 
+    // At most one recv and one send are outstanding per socket, so their ops live here.
+    NetIoBuffer     _recvOP;
+    NetIoBuffer     _sendOP;
+    NetCompletionOP _resumeOP;
+    std::atomic<bool> _resumeQueued;
+    HANDLE          _comPort;
+
+    // Receive state is owned by the single outstanding recv and needs no lock.
     CircularBuffer  _recvBuffer;
-    SafeLock        _recvLock;
+    OwnerChecker    _recvOwner;
+    FloodGuard      _floodGuard;
+    NetFloodPolicy  _floodPolicy;
+    HANDLE          _resumeTimer;
+    // an armed timer holds an I/O reference; whoever clears this owns it
+    std::atomic<bool> _resumeArmed;
+
+    RecvMemoryBudget*   _recvBudget;
+    std::atomic<uint64> _ringBytes;
+    std::atomic<uint64> _postedBytes;
+
+    NetRecvMode     _recvMode;
+
+    NetTimeoutPolicy    _timeoutPolicy;
+    NetTimerWheel*      _timerWheel;
+    uint64              _connectedTick;
+    std::atomic<uint64> _lastRecvTick;  // 0 until the first inbound data
+    uint64              _lastPingTick;
+    RttEstimator        _rtt;
+
+    std::vector<char>   _adoptedData;
+    std::vector<char>   _adoptedSend;
+
+    // sends taken by CollectHandoff, oldest first
+    std::vector<MemoryBlock*> _handoffSends;
 };
 
 } // namespace RefLib
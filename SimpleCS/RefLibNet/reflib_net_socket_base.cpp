@@ -2,6 +2,7 @@
 
 #include "reflib_net_socket_base.h"
 #include "reflib_net_api.h"
+#include "reflib_net_profiler.h"
 
 namespace RefLib
 {
@@ -12,9 +13,11 @@ namespace RefLib
 NetSocketBase::NetSocketBase()
     : _socket(INVALID_SOCKET)
     , _netStatus(NET_STATUS_DISCONNECTED) 
+    , _profiler(nullptr)
+    , _connectOP(NetCompletionOP::OP_CONNECT)
+    , _disconnectOP(NetCompletionOP::OP_DISCONNECT)
+    , _ioRefs(0)
 {
-    _connectOP = new NetCompletionOP(NetCompletionOP::OP_CONNECT);
-    _disconnectOP = new NetCompletionOP(NetCompletionOP::OP_DISCONNECT);
 }
 
 void NetSocketBase::SetSocket(SOCKET sock)
@@ -28,15 +31,38 @@ bool NetSocketBase::Connect(SOCKET sock, const SOCKADDR_IN& addr)
     SetSocket(sock);
 
     _netStatus.fetch_or(NET_STATUS_CONN_PENDING);
-    _connectOP->Reset(_socket);
-    return g_network.Connect(_connectOP, addr);
+    _connectOP.Reset(_socket);
+
+    if (_profiler)
+        _profiler->OnOpPosted(NetCompletionOP::OP_CONNECT);
+
+    AddIoRef();
+    if (g_network.Connect(&_connectOP, addr))
+        return true;
+
+    if (ReleaseIoRef())
+        OnIoReleased();
+    return false;
 }
 
 void NetSocketBase::Disconnect(NetCloseType closer)
 {
-    _netStatus.fetch_or(NET_STATUS_CLOSE_PENDING);
-    _disconnectOP->Reset(_socket);
-    g_network.Disconnect(_disconnectOP, closer);
+    // the embedded op is still in flight for an earlier close
+    if (_netStatus.fetch_or(NET_STATUS_CLOSE_PENDING) & NET_STATUS_CLOSE_PENDING)
+    {
+        if (_profiler)
+            _profiler->OnOpBusy(NetCompletionOP::OP_DISCONNECT);
+        return;
+    }
+
+    _disconnectOP.Reset(_socket);
+
+    if (_profiler)
+        _profiler->OnOpPosted(NetCompletionOP::OP_DISCONNECT);
+
+    AddIoRef();
+    if (!g_network.Disconnect(&_disconnectOP, closer) && ReleaseIoRef())
+        OnIoReleased();
 }
 
 void NetSocketBase::OnConnected()
@@ -54,7 +80,8 @@ void NetSocketBase::OnDisconnected()
 	}
 	else
 	{
-		_netStatus.fetch_and((~NET_STATUS_CONNECTED) & (~NET_STATUS_RECV_PENDING) & (~NET_STATUS_CLOSE_PENDING));
+		_netStatus.fetch_and((~NET_STATUS_CONNECTED) & (~NET_STATUS_RECV_PENDING) & (~NET_STATUS_CLOSE_PENDING)
+			& (~NET_STATUS_RECV_PAUSED));
 		if (_netStatus != 0)
 		{
 			DebugPrint("OnDisconnected: closed without clearing pending status 0x%x", _netStatus.load());
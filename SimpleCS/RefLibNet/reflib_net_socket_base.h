@@ -8,6 +8,7 @@ namespace RefLib
 {
 
 class MemoryBlock;
+class NetProfiler;
 
 class NetSocketBase : public NetCompletionTarget
 {
@@ -18,20 +19,42 @@ public:
     void SetSocket(SOCKET sock);
     SOCKET GetSocket() const { return _socket; }
 
+    void SetProfiler(NetProfiler* profiler) { _profiler = profiler; }
+
+    // connected and not closing
+    bool IsConnected() const
+    {
+        int status = _netStatus.load();
+        return (status & NET_STATUS_CONNECTED) && !(status & NET_STATUS_CLOSE_PENDING);
+    }
+
+    // the socket is being passed to another process, which owns its teardown
+    bool IsHandingOff() const { return (_netStatus.load() & NET_STATUS_HANDOFF) != 0; }
+
     bool Connect(SOCKET sock, const SOCKADDR_IN& addr);
     void Disconnect(NetCloseType closer);
 
+    // One reference per overlapped op from its post to its completion, plus
+    // one the connection manager holds while the socket is in use. Whoever
+    // drops the last one gets true and must not touch the socket afterwards.
+    void AddIoRef() { _ioRefs.fetch_add(1); }
+    bool ReleaseIoRef() { return _ioRefs.fetch_sub(1) == 1; }
+    // the last reference was dropped by I/O, after the manager let go
+    virtual void OnIoReleased() {}
+
     virtual void OnConnected();
     virtual void OnDisconnected();
 
 protected:
     std::atomic<int> _netStatus;
+    NetProfiler* _profiler;
 
 private:
-    NetCompletionOP* _connectOP;
-    NetCompletionOP* _disconnectOP;
+    NetCompletionOP _connectOP;
+    NetCompletionOP _disconnectOP;
 
     std::atomic<SOCKET> _socket;
+    std::atomic<int> _ioRefs;
 };
 
 } // namespace RefLib
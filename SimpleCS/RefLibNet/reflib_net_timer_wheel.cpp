@@ -0,0 +1,193 @@
+#include "stdafx.h"
+
+#include "reflib_net_timer_wheel.h"
+
+namespace RefLib
+{
+
+NetTimerWheel::NetTimerWheel()
+    : _currentTick(GetTickCount64() / NET_TIMER_TICK_MSEC)
+    , _advancing(false)
+    , _advanceThread(0)
+    , _armedCnt(0)
+    , _expiredLastTick(0)
+    , _expiredMaxTick(0)
+{
+    for (auto& bucket : _buckets)
+        bucket = nullptr;
+    for (auto& timeouts : _timeouts)
+        timeouts = 0;
+}
+
+NetTimerWheel::~NetTimerWheel()
+{
+}
+
+void NetTimerWheel::Arm(NetTimerTarget* target, uint64 deadline)
+{
+    REFLIB_ASSERT_RETURN_IF_FAILED(target, "NetTimerWheel::Arm: target is null");
+
+    SafeLock::Owner lock(_lock);
+
+    // armed again after a cancel: a callback still due runs after all
+    target->_timerCancelled = false;
+
+    Unlink(target);
+    Link(target, deadline);
+}
+
+void NetTimerWheel::Cancel(NetTimerTarget* target)
+{
+    REFLIB_ASSERT_RETURN_IF_FAILED(target, "NetTimerWheel::Cancel: target is null");
+
+    {
+        SafeLock::Owner lock(_lock);
+
+        Unlink(target);
+        if (!target->_timerFiring)
+            return;
+
+        target->_timerCancelled = true;
+    }
+
+    // From a callback: its own target finishes on return, and a target still
+    // waiting in this thread's due list is skipped.
+    if (_advanceThread.load() == ::GetCurrentThreadId())
+        return;
+
+    while (target->_timerFiring.load())
+    {
+        YieldProcessor();
+    }
+}
+
+// must hold _lock
+void NetTimerWheel::Link(NetTimerTarget* target, uint64 deadline)
+{
+    uint64 current = _currentTick;
+    uint64 tick = deadline / NET_TIMER_TICK_MSEC;
+    if (tick < current)
+        tick = current;
+
+    int bucket = static_cast<int>(tick & (NET_TIMER_WHEEL_SIZE - 1));
+
+    target->_timerRounds = (tick - current) / NET_TIMER_WHEEL_SIZE;
+    target->_timerBucket = bucket;
+    target->_timerPrev = nullptr;
+    target->_timerNext = _buckets[bucket];
+    if (_buckets[bucket])
+        _buckets[bucket]->_timerPrev = target;
+    _buckets[bucket] = target;
+
+    ++_armedCnt;
+}
+
+// must hold _lock
+void NetTimerWheel::Unlink(NetTimerTarget* target)
+{
+    if (target->_timerBucket < 0)
+        return;
+
+    if (target->_timerPrev)
+        target->_timerPrev->_timerNext = target->_timerNext;
+    else
+        _buckets[target->_timerBucket] = target->_timerNext;
+
+    if (target->_timerNext)
+        target->_timerNext->_timerPrev = target->_timerPrev;
+
+    target->_timerPrev = nullptr;
+    target->_timerNext = nullptr;
+    target->_timerBucket = -1;
+
+    --_armedCnt;
+}
+
+void NetTimerWheel::Advance(uint64 now)
+{
+    uint64 nowTick = now / NET_TIMER_TICK_MSEC;
+    if (nowTick < _currentTick)
+        return;
+
+    if (_advancing.exchange(true))
+        return;
+
+    _advanceThread = ::GetCurrentThreadId();
+
+    while (_currentTick <= nowTick)
+    {
+        NetTimerTarget* expired = nullptr;
+
+        // detach what is due under the lock; the callbacks run without it
+        {
+            SafeLock::Owner lock(_lock);
+
+            int bucket = static_cast<int>(_currentTick & (NET_TIMER_WHEEL_SIZE - 1));
+
+            NetTimerTarget* target = _buckets[bucket];
+            while (target)
+            {
+                NetTimerTarget* next = target->_timerNext;
+                if (target->_timerRounds > 0)
+                {
+                    --target->_timerRounds;
+                }
+                else
+                {
+                    Unlink(target);
+                    target->_timerFiring = true;
+                    target->_timerCancelled = false;
+                    target->_timerExpiredNext = expired;
+                    expired = target;
+                }
+                target = next;
+            }
+
+            ++_currentTick;
+        }
+
+        uint64 expiredCnt = 0;
+        while (expired)
+        {
+            NetTimerTarget* target = expired;
+            expired = target->_timerExpiredNext;
+            target->_timerExpiredNext = nullptr;
+
+            uint64 deadline = 0;
+            if (!target->_timerCancelled)
+            {
+                deadline = target->OnTimer(now);
+                ++expiredCnt;
+            }
+
+            SafeLock::Owner lock(_lock);
+
+            // an Arm during the callback wins over the deadline it returned
+            if (deadline != 0 && !target->_timerCancelled && target->_timerBucket < 0)
+                Link(target, deadline);
+
+            target->_timerCancelled = false;
+            // a waiting Cancel may free the target from here on
+            target->_timerFiring = false;
+        }
+
+        _expiredLastTick = expiredCnt;
+        if (expiredCnt > _expiredMaxTick)
+            _expiredMaxTick = expiredCnt;
+    }
+
+    _advanceThread = 0;
+    _advancing = false;
+}
+
+void NetTimerWheel::PrintStatistics()
+{
+    DebugPrint("Timers: armed(%llu) expired last tick(%llu) max per tick(%llu)",
+        _armedCnt.load(), _expiredLastTick.load(), _expiredMaxTick.load());
+    DebugPrint("Timeouts: handshake(%llu) idle(%llu) keepalive(%llu)",
+        _timeouts[NET_TIMEOUT_HANDSHAKE].load(),
+        _timeouts[NET_TIMEOUT_IDLE].load(),
+        _timeouts[NET_TIMEOUT_KEEPALIVE].load());
+}
+
+} // namespace RefLib
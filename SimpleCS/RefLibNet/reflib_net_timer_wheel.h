@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include "reflib_type_def.h"
+#include "reflib_net_def.h"
+#include "reflib_safelock.h"
+
+namespace RefLib
+{
+
+struct NetTimeoutPolicy
+{
+    NetTimeoutPolicy()
+        : handshakeMsec(0)
+        , idleMsec(0)
+        , keepAliveMsec(0)
+    {
+    }
+
+    // 0 disables the deadline
+    uint32 handshakeMsec;
+    uint32 idleMsec;
+    uint32 keepAliveMsec;   // heartbeat ping interval
+};
+
+class NetTimerWheel;
+
+// Intrusive wheel entry. A target is on the wheel at most once.
+class NetTimerTarget
+{
+public:
+    NetTimerTarget()
+        : _timerPrev(nullptr)
+        , _timerNext(nullptr)
+        , _timerExpiredNext(nullptr)
+        , _timerRounds(0)
+        , _timerBucket(-1)
+        , _timerFiring(false)
+        , _timerCancelled(false)
+    {
+    }
+    virtual ~NetTimerTarget() {}
+
+    // Called on a worker thread outside the wheel lock, so it may arm, cancel
+    // or close; must not block. Returns the next deadline, or 0 to leave the wheel.
+    virtual uint64 OnTimer(uint64 now) = 0;
+
+private:
+    friend class NetTimerWheel;
+
+    NetTimerTarget* _timerPrev;
+    NetTimerTarget* _timerNext;
+    NetTimerTarget* _timerExpiredNext;  // the advancing thread's list of due targets
+    uint64 _timerRounds;
+    int _timerBucket;
+
+    // set under the wheel lock from detach until the callback is done
+    std::atomic<bool> _timerFiring;
+    std::atomic<bool> _timerCancelled;
+};
+
+// Hashed timing wheel with NET_TIMER_TICK_MSEC resolution. Arm, re-arm and
+// cancel are O(1); deadlines past one revolution wait out extra rounds in
+// their bucket. Worker threads advance it whenever they wake up.
+class NetTimerWheel
+{
+public:
+    NetTimerWheel();
+    ~NetTimerWheel();
+
+    void Arm(NetTimerTarget* target, uint64 deadline);
+    // Once it returns the callback is not running and will not run, unless
+    // called from a callback on the advancing thread, which does not wait.
+    void Cancel(NetTimerTarget* target);
+
+    // Fires every bucket up to now. Only one thread advances at a time; the rest return.
+    void Advance(uint64 now);
+
+    void OnTimeout(NetTimeoutType type) { _timeouts[type].fetch_add(1); }
+
+    uint64 GetTimeouts(NetTimeoutType type) const { return _timeouts[type]; }
+    uint64 GetExpiredLastTick() const { return _expiredLastTick; }
+    uint64 GetExpiredMaxTick() const { return _expiredMaxTick; }
+    uint64 GetArmedCount() const { return _armedCnt; }
+
+    void PrintStatistics();
+
+private:
+    void Link(NetTimerTarget* target, uint64 deadline);
+    void Unlink(NetTimerTarget* target);
+
+    NetTimerTarget* _buckets[NET_TIMER_WHEEL_SIZE];
+    std::atomic<uint64> _currentTick;     // next tick to fire
+    std::atomic<bool> _advancing;
+    std::atomic<DWORD> _advanceThread;
+    SafeLock _lock;
+
+    std::atomic<uint64> _armedCnt;
+    std::atomic<uint64> _expiredLastTick;
+    std::atomic<uint64> _expiredMaxTick;
+    std::atomic<uint64> _timeouts[NET_TIMEOUT_TYPE_CNT];
+};
+
+} // namespace RefLib
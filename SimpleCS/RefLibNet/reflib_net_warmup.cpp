@@ -0,0 +1,142 @@
+#include "stdafx.h"
+
+#include <process.h>
+#include <psapi.h>
+#include "reflib_net_warmup.h"
+#include "reflib_net_connection.h"
+#include "reflib_memory_pool.h"
+
+#pragma comment(lib, "psapi")
+
+// pool blocks or connections handled by one task
+#define WARMUP_POOL_TASK_BLOCKS     1024
+#define WARMUP_RING_TASK_CONNS      64
+
+namespace RefLib
+{
+
+void NetWarmupConfig::SetPoolBlocks(unsigned int bufLen, uint32 count)
+{
+    int sizeClass = MemoryPool::GetSizeClass(bufLen);
+    REFLIB_ASSERT_RETURN_IF_FAILED(sizeClass != MEMORY_BLOCK_HEAP_CLASS, "Buffer is larger than the largest pool class");
+
+    poolBlocks[sizeClass] = count;
+}
+
+NetWarmup::NetWarmup(const NetWarmupConfig& config, std::vector<std::shared_ptr<NetConnection>>&& cons)
+    : _config(config)
+    , _cons(std::move(cons))
+    , _nextTask(0)
+{
+}
+
+uint64 NetWarmup::GetResidentBytes()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return counters.WorkingSetSize;
+}
+
+bool NetWarmup::Run(NetWarmupReport& report)
+{
+    uint64 start = GetTickCount64();
+    report.rssBefore = GetResidentBytes();
+
+    for (int i = 0; i < MEMORY_POOL_CLASS_CNT; ++i)
+    {
+        for (uint32 begin = 0; begin < _config.poolBlocks[i]; begin += WARMUP_POOL_TASK_BLOCKS)
+        {
+            Task task = { i, begin, (std::min)(begin + WARMUP_POOL_TASK_BLOCKS, _config.poolBlocks[i]) };
+            _tasks.push_back(task);
+        }
+        report.poolBlocks += _config.poolBlocks[i];
+    }
+
+    if (_config.prefaultRings)
+    {
+        uint32 conCnt = static_cast<uint32>(_cons.size());
+        for (uint32 begin = 0; begin < conCnt; begin += WARMUP_RING_TASK_CONNS)
+        {
+            Task task = { MEMORY_BLOCK_HEAP_CLASS, begin, (std::min)(begin + WARMUP_RING_TASK_CONNS, conCnt) };
+            _tasks.push_back(task);
+        }
+        report.rings = conCnt;
+    }
+
+    uint32 threadCnt = _config.threadCnt;
+    if (threadCnt == 0)
+    {
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo(&sysInfo);
+        threadCnt = sysInfo.dwNumberOfProcessors;
+    }
+    threadCnt = (std::min)(threadCnt, static_cast<uint32>(MAXIMUM_WAIT_OBJECTS));
+    threadCnt = (std::min)(threadCnt, static_cast<uint32>(_tasks.size()));
+
+    std::vector<HANDLE> threads;
+    for (uint32 i = 0; i < threadCnt; ++i)
+    {
+        HANDLE hThread = reinterpret_cast<HANDLE>(
+            _beginthreadex(0, 0, ThreadProc, static_cast<void*>(this), 0, nullptr));
+        if (hThread == 0)
+        {
+            DebugPrint("Warmup: failed to create thread");
+            break;
+        }
+        threads.push_back(hThread);
+    }
+
+    // whatever the threads do not pick up runs here
+    RunTasks();
+
+    if (!threads.empty())
+    {
+        ::WaitForMultipleObjects(static_cast<DWORD>(threads.size()), &threads[0], TRUE, INFINITE);
+        for (auto hThread : threads)
+            ::CloseHandle(hThread);
+    }
+
+    report.rssAfter = GetResidentBytes();
+    report.elapsedMsec = GetTickCount64() - start;
+
+    DebugPrint("Warmup: %llu msec on %d threads, pool blocks(%llu) rings(%llu), resident %llu -> %llu bytes",
+        report.elapsedMsec, static_cast<int>(threads.size()) + 1, report.poolBlocks, report.rings,
+        report.rssBefore, report.rssAfter);
+
+    return true;
+}
+
+unsigned __stdcall NetWarmup::ThreadProc(void* param)
+{
+    NetWarmup* warmup = static_cast<NetWarmup*>(param);
+    warmup->RunTasks();
+
+    // the carved blocks wait in the depot, not in this thread's cache
+    g_memoryPool.FlushThreadCache();
+
+    return 0;
+}
+
+void NetWarmup::RunTasks()
+{
+    uint32 idx;
+    while ((idx = _nextTask.fetch_add(1)) < _tasks.size())
+    {
+        const Task& task = _tasks[idx];
+
+        if (task.sizeClass != MEMORY_BLOCK_HEAP_CLASS)
+        {
+            g_memoryPool.Prefill(task.sizeClass, task.end - task.begin);
+            continue;
+        }
+
+        for (uint32 i = task.begin; i < task.end; ++i)
+        {
+            _cons[i]->Prefault();
+        }
+    }
+}
+
+} // namespace RefLib
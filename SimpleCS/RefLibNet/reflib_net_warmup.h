@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "reflib_type_def.h"
+#include "reflib_def.h"
+
+namespace RefLib
+{
+
+class NetConnection;
+
+struct NetWarmupConfig
+{
+    NetWarmupConfig()
+        : threadCnt(0)
+        , connections(0)
+        , prefaultRings(true)
+    {
+        for (auto& blocks : poolBlocks)
+            blocks = 0;
+    }
+
+    // blocks to carve and touch for buffers of bufLen bytes
+    void SetPoolBlocks(unsigned int bufLen, uint32 count);
+
+    uint32 threadCnt;                           // 0 uses one thread per processor
+    uint32 connections;                         // idle connections to build ahead of traffic
+    uint32 poolBlocks[MEMORY_POOL_CLASS_CNT];   // per pool size class
+    bool prefaultRings;                         // touch the receive ring of every connection
+};
+
+struct NetWarmupReport
+{
+    NetWarmupReport() : elapsedMsec(0), rssBefore(0), rssAfter(0), poolBlocks(0), rings(0) {}
+
+    uint64 elapsedMsec;
+    uint64 rssBefore;
+    uint64 rssAfter;
+    uint64 poolBlocks;
+    uint64 rings;
+};
+
+// Opt-in warm start: pre-carves pool slabs and pre-faults connection rings on
+// a set of short-lived threads before the service starts taking traffic.
+// Socket I/O ops are embedded in the connections and are warmed with them.
+class NetWarmup
+{
+public:
+    NetWarmup(const NetWarmupConfig& config, std::vector<std::shared_ptr<NetConnection>>&& cons);
+
+    bool Run(NetWarmupReport& report);
+
+private:
+    struct Task
+    {
+        int sizeClass;      // MEMORY_BLOCK_HEAP_CLASS for a ring task
+        uint32 begin;
+        uint32 end;
+    };
+
+    static unsigned __stdcall ThreadProc(void* param);
+    void RunTasks();
+
+    static uint64 GetResidentBytes();
+
+    NetWarmupConfig _config;
+    std::vector<std::shared_ptr<NetConnection>> _cons;
+
+    std::vector<Task> _tasks;
+    std::atomic<uint32> _nextTask;
+};
+
+} // namespace RefLib
@@ -17,8 +17,13 @@ NetWorker::NetWorker(NetService* container)
 
 bool NetWorker::Initialize(unsigned int concurrency)
 {
-    _comPort = g_network.GetCompletionPort();
-    if (_comPort == INVALID_HANDLE_VALUE)
+    return Initialize(g_network.GetCompletionPort(), concurrency, -1);
+}
+
+bool NetWorker::Initialize(HANDLE comPort, unsigned int concurrency, int processor)
+{
+    _comPort = comPort;
+    if (_comPort == INVALID_HANDLE_VALUE || _comPort == nullptr)
     {
         DebugPrint("Completion port is null");
         return false;
@@ -27,6 +32,11 @@ bool NetWorker::Initialize(unsigned int concurrency)
     if (!CreateThreads(concurrency))
         return false;
 
+    if (processor >= 0)
+        PinToProcessor(processor);
+    else if (_container && _container->IsNumaPinning())
+        PinToNumaNodes();
+
     NetProfiler::StartProfile();
     RunableThreads::Activate();
 
@@ -41,8 +51,11 @@ void NetWorker::Run()
     int error = NO_ERROR;
     DWORD flags;
 
+    // wake at least once a tick so deadlines fire on an idle server
     BOOL rc = GetQueuedCompletionStatus(_comPort, &bytesTransfered,
-        (PULONG_PTR)&sockObj, &lpOverlapped, THREAD_TIMEOUT_IN_MSEC);
+        (PULONG_PTR)&sockObj, &lpOverlapped, NET_TIMER_TICK_MSEC);
+
+    _timerWheel.Advance(GetTickCount64());
 
     if (rc == FALSE)
     {
@@ -69,18 +82,28 @@ void NetWorker::HandleIO(NetSocketBase* sockObj, OVERLAPPED* lpOverlapped, DWORD
 
     if (error != NO_ERROR)
     {
-        if (bytesTransfered == 0)
+        // let the socket recycle its op before it is torn down
+        sockObj->OnCompletionFailure(bufObj, bytesTransfered, error);
+
+        // A recv cancelled for a handoff does not close the connection, and a
+        // failed accept is the client's; the listener handles both itself.
+        if (bytesTransfered == 0 && !sockObj->IsHandingOff() && bufObj->op != NetCompletionOP::OP_ACCEPT)
             sockObj->OnDisconnected();
-        else           
-            sockObj->OnCompletionFailure(bufObj, bytesTransfered, error);
     }
     else
     {
-        _bytesSent.fetch_add(bytesTransfered);
-        _bytesSentLast.fetch_add(bytesTransfered);
+        if (bufObj->op == NetCompletionOP::OP_WRITE)
+        {
+            _bytesSent.fetch_add(bytesTransfered);
+            _bytesSentLast.fetch_add(bytesTransfered);
+        }
 
         sockObj->OnCompletionSuccess(bufObj, bytesTransfered);
     }
+
+    // the op's reference kept the socket alive through the handlers above
+    if (sockObj->ReleaseIoRef())
+        sockObj->OnIoReleased();
 }
 
 void NetWorker::OnDeactivated()
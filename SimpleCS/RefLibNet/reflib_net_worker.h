@@ -2,6 +2,7 @@
 
 #include "reflib_runable_threads.h"
 #include "reflib_net_profiler.h"
+#include "reflib_net_timer_wheel.h"
 #include <memory>
 
 namespace RefLib
@@ -20,9 +21,14 @@ public:
     virtual ~NetWorker() {}
 
     virtual bool Initialize(unsigned int concurrency);
+    // waits on comPort instead of the shared one; processor -1 leaves the threads unpinned
+    bool Initialize(HANDLE comPort, unsigned int concurrency, int processor);
 
     virtual void OnDeactivated() override;
 
+    // connection deadlines, advanced by this worker's threads
+    NetTimerWheel& GetTimerWheel() { return _timerWheel; }
+
 protected:
     // run by thread
     virtual void Run() override;
@@ -31,6 +37,7 @@ protected:
 private:
     HANDLE _comPort;
     NetService* _container;
+    NetTimerWheel _timerWheel;
 };
 
 } // namespace RefLib
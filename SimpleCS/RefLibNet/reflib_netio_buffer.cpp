@@ -12,32 +12,45 @@ namespace RefLib
 
 NetIoBuffer::~NetIoBuffer()
 {
-	MemoryBlock* buffer;
+	ReleaseData();
+}
 
-	while (buffer = PopData())
+MemoryBlock* NetIoBuffer::Alloc(int32 buffLen)
+{
+	MemoryBlock* buffer = g_memoryPool.GetBuffer(buffLen, (op == OP_READ) ? MEMORY_TAG_RECV : MEMORY_TAG_SEND);
+	if (!PushData(buffer))
 	{
 		g_memoryPool.FreeBuffer(buffer);
+		return nullptr;
 	}
+
+	return buffer;
 }
 
-MemoryBlock* NetIoBuffer::Alloc(int32 buffLen)
+bool NetIoBuffer::PushData(MemoryBlock* data)
 {
-	MemoryBlock* buffer = g_memoryPool.GetBuffer(MAX_PACKET_SIZE);
-	_data.push(buffer);
+	REFLIB_ASSERT_RETURN_VAL_IF_FAILED(_dataCnt < MAX_SEND_ARRAY_SIZE, "NetIoBuffer is full", false);
 
-	return buffer;
+	_data[_dataCnt++] = data;
+	return true;
 }
 
 MemoryBlock* NetIoBuffer::PopData()
 {
-	MemoryBlock* buffer = nullptr;
+	if (_dataCnt == 0)
+		return nullptr;
 
-	if (!_data.empty())
+	return _data[--_dataCnt];
+}
+
+void NetIoBuffer::ReleaseData()
+{
+	MemoryBlock* buffer;
+
+	while (buffer = PopData())
 	{
-		buffer = _data.front();
-		_data.pop();
+		g_memoryPool.FreeBuffer(buffer);
 	}
-	return buffer;
 }
 
 } // namespace RefLib
\ No newline at end of file
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <queue>
 #include "reflib_net_completion.h"
 
 namespace RefLib
@@ -8,20 +7,24 @@ namespace RefLib
 
 class MemoryBlock;
 
+// Embedded in each socket and reused for every post, so it never touches the heap.
 class NetIoBuffer : public NetCompletionOP
 {
 public:
-	NetIoBuffer(NetOPType op) : NetCompletionOP(op) {}
+	NetIoBuffer(NetOPType op) : NetCompletionOP(op), _dataCnt(0) {}
 	~NetIoBuffer();
 
 	MemoryBlock* Alloc(int32 buffLen);
 
-	void PushData(MemoryBlock* data) { _data.push(data); }
-	inline MemoryBlock* PopData();
+	bool PushData(MemoryBlock* data);
+	MemoryBlock* PopData();
 
-private:
+	// return every attached buffer to the pool
+	void ReleaseData();
 
-	std::queue<MemoryBlock*> _data;
+private:
+	MemoryBlock* _data[MAX_SEND_ARRAY_SIZE];
+	uint32 _dataCnt;
 };
 
 } // namespace RefLib
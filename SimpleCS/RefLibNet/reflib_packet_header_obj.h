@@ -7,6 +7,7 @@ namespace RefLib
 {
 
 #define PACKET_ENVELOP_TAG      0xffaa
+#define PACKET_CONTROL_TAG      0xffab      // handled inside NetSocket, never delivered
 #define PACKET_HEADER_SIZE      PacketHeaderObj::GetHeaderSize()
 #define MAX_PACKET_CONTENT_SIZE (MAX_PACKET_SIZE - PACKET_HEADER_SIZE)
 
@@ -18,15 +19,20 @@ public:
         return sizeof(header.blob);
     }
 
-    void SetHeader(uint16 contentLen)
+    void SetHeader(uint16 contentLen, uint16 envTag = PACKET_ENVELOP_TAG)
     {
-        header.info.envTag = PACKET_ENVELOP_TAG;
+        header.info.envTag = envTag;
         header.info.contentLen = contentLen;
     }
 
     bool IsValidEnvTag() const
     {
-        return (header.info.envTag == PACKET_ENVELOP_TAG);
+        return (header.info.envTag == PACKET_ENVELOP_TAG || header.info.envTag == PACKET_CONTROL_TAG);
+    }
+
+    bool IsControl() const
+    {
+        return (header.info.envTag == PACKET_CONTROL_TAG);
     }
 
     bool IsValidContentLength() const